@@ -10,14 +10,17 @@
 #include "esp_wifi.h"
 #include <WiFi.h>
 #include <Wire.h>
-
-#define RELAY_BOMBA 21
-#define RELAY_VENTILADOR 22
-#define LED_PIN 18
-#define AIRE 17
-
-int a = 13, b = 12, c = 14, d = 27, e = 26, f = 25, g = 33;
-int pins[] = {a, b, c, d, e, f, g};
+#include <Preferences.h>
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "../prueba_3_corete/config_blob.h"
+#include "puerto_salidas.h"
+#include "comandos.h"
+#include "perfil.h"
+
+// Pines y puerto de salidas en puerto_salidas.h; tramas, estado de salidas y
+// canal de alarma crítica en comandos.h
 
 // Inclusión condicional para ESP8266 o ESP32
 #ifdef ESP32
@@ -33,179 +36,309 @@ static const BaseType_t app_cpu = 0;
 static const BaseType_t app_cpu = 1;
 #endif
 
-// Variables de estado
-bool Ventilador = false;
-bool Bomba = false;
-bool Led = false;
-bool Alarma = false;
-bool Calor = false;
+// Configuración recargable (la MAC del emisor es cfgActiva->macNucleoC)
+// Formato, CRC y valores por defecto en prueba_3_corete/config_blob.h
 
-// Dirección MAC del emisor
-uint8_t macNucleoC[6] = {0xC8, 0xF0, 0x9E, 0x7B, 0x78, 0x88};
+/// Configuración en uso. Cada decisión copia el puntero una sola vez al empezar.
+const ConfigBlob * volatile cfgActiva = &cfgPorDefecto;
 
-/**
- * @brief Estructura para recibir estados de los dispositivos.
- */
-typedef struct struct_message {
-  bool eVentilador;
-  bool eBomba;
-  bool eLed;
-  bool eAlarma;
-  bool eCalor;
-} struct_message;
-
-struct_message incomingReadings;
-esp_now_peer_info_t peerInfo;
-char macStr[18];
+const esp_partition_t *cfgParticion = NULL;
+const uint8_t *cfgMapa = NULL;            // Las dos ranuras mapeadas en memoria
+esp_partition_mmap_handle_t cfgMapaHandle;
+ConfigBlob cfgPendiente;                  // Recibida por ESP-NOW, aún sin escribir
+volatile bool cfgHayPendiente = false;
+int64_t cfgUltimaConmutacion = 0;
+
+// Mediciones (microsegundos)
+int64_t cfgTiempoArranque = 0;
+int64_t cfgTiempoEscritura = 0;
+int64_t cfgTiempoConmutacion = 0;
 
 /**
- * @brief Agrega un peer al sistema ESP-NOW.
- * @param mac Dirección MAC del dispositivo a emparejar.
+ * @brief Devuelve la ranura i de la partición mapeada.
  */
-void addPeer(uint8_t *mac) {
-  memcpy(peerInfo.peer_addr, mac, 6);
-  peerInfo.channel = 0;
-  peerInfo.encrypt = false;
-
-  if (esp_now_add_peer(&peerInfo) != ESP_OK) {
-    Serial.println("Fallo al agregar peer");
-  } else {
-    Serial.println("Peer agregado con éxito");
-    snprintf(macStr, sizeof(macStr), "%02X:%02X:%02X:%02X:%02X:%02X",
-             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-    Serial.println(macStr);
-  }
+const ConfigBlob *cfgRanura(int i) {
+  return (const ConfigBlob *) (cfgMapa + i * CFG_TAM_RANURA);
 }
 
 /**
- * @brief Callback al recibir datos por ESP-NOW.
+ * @brief Mapea la partición de configuración y activa la ranura válida más reciente.
  */
-void OnDataRecv(const esp_now_recv_info_t *info, const uint8_t *incomingData, int len) {
-  memcpy(&incomingReadings, incomingData, sizeof(incomingReadings));
-
-  snprintf(macStr, sizeof(macStr), "%02X:%02X:%02X:%02X:%02X:%02X",
-           info->src_addr[0], info->src_addr[1], info->src_addr[2],
-           info->src_addr[3], info->src_addr[4], info->src_addr[5]);
-
-  if (memcmp(info->src_addr, macNucleoC, 6) == 0) {  
-    Serial.print("Ventilador encendido: ");
-    Serial.println(incomingReadings.eVentilador);
-    Ventilador = incomingReadings.eVentilador;
-
-    Serial.print("Bomba encendida: ");
-    Serial.println(incomingReadings.eBomba);
-    Bomba = incomingReadings.eBomba;
-
-    Serial.print("Led encendido: ");
-    Serial.println(incomingReadings.eLed);
-    Led = incomingReadings.eLed;
-
-    Serial.print("Alarma de fuego encendida: ");
-    Serial.println(incomingReadings.eAlarma);
-    Alarma = incomingReadings.eAlarma;
-
-    Serial.print("Aire acondicionado encendido: ");
-    Serial.println(incomingReadings.eCalor);
-    Calor = incomingReadings.eCalor;
+void cfgIniciar() {
+  int64_t t0 = esp_timer_get_time();
+  cfgParticion = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "invcfg");
+  if (cfgParticion == NULL || cfgParticion->size < 2 * CFG_TAM_RANURA ||
+      esp_partition_mmap(cfgParticion, 0, 2 * CFG_TAM_RANURA, ESP_PARTITION_MMAP_DATA,
+                         (const void **) &cfgMapa, &cfgMapaHandle) != ESP_OK) {
+    cfgMapa = NULL;
+    Serial.println("⚠️ Sin partición de configuración, se usan los valores de compilación");
   } else {
-    Serial.println("MAC desconocida");
+    for (int i = 0; i < 2; i++) {
+      const ConfigBlob *c = cfgRanura(i);
+      if (cfgEsValida(c) && c->generacion > cfgActiva->generacion) {
+        cfgActiva = c;
+      }
+    }
   }
+  cfgTiempoArranque = esp_timer_get_time() - t0;
+  Serial.printf("Configuración generación %u cargada en %lld us\n",
+                (unsigned) cfgActiva->generacion, cfgTiempoArranque);
 }
 
 /**
- * @brief Enciende o apaga el ventilador.
+ * @brief Acepta una configuración recibida por ESP-NOW si es válida, más nueva
+ * y enviada por el nodo central.
+ * @param origen MAC del remitente.
+ * @return true si el mensaje era una configuración (válida o no).
+ *
+ * Se llama desde el callback de recepción, por eso solo copia a RAM; la
+ * escritura en flash la hace cfgAplicarPendiente() desde loop().
  */
-void encenderVentilador(){
-  digitalWrite(RELAY_VENTILADOR, Ventilador ? LOW : HIGH); 
+bool cfgRecibir(const uint8_t *origen, const uint8_t *incomingData, int len) {
+  ConfigBlob nueva;
+  switch (cfgEvaluar(incomingData, len, origen, cfgActiva, &nueva)) {
+    case CFG_NO_ES_CONFIG:
+      return false;
+    case CFG_ORIGEN_DESCONOCIDO:
+      Serial.println("Configuración descartada: no viene del nodo central");
+      break;
+    case CFG_INVALIDA:
+      Serial.println("Configuración descartada: CRC, firma o versión incorrectos");
+      break;
+    case CFG_ANTIGUA:
+      Serial.println("Configuración descartada: generación antigua");
+      break;
+    case CFG_ACEPTADA:
+      if (!cfgHayPendiente) {
+        cfgPendiente = nueva;
+        cfgHayPendiente = true;
+      }
+      break;
+  }
+  return true;
 }
 
 /**
- * @brief Enciende o apaga la bomba.
+ * @brief Escribe la configuración pendiente en la ranura inactiva y conmuta.
+ *
+ * La ranura que se borra es la que estaba activa antes de la última
+ * conmutación; CFG_INTERVALO_MIN_MS garantiza que ningún lector la siga usando.
  */
-void encenderBomba(){
-  digitalWrite(RELAY_BOMBA, Bomba ? LOW : HIGH);
-}
+void cfgAplicarPendiente() {
+  if (!cfgHayPendiente) {
+    return;
+  }
+  if (cfgMapa == NULL) {
+    Serial.println("❌ No hay partición donde guardar la configuración");
+    cfgHayPendiente = false;
+    return;
+  }
+  if (esp_timer_get_time() - cfgUltimaConmutacion < CFG_INTERVALO_MIN_MS * 1000LL) {
+    return;
+  }
 
-/**
- * @brief Enciende o apaga el LED.
- */
-void encenderLed(){
-  digitalWrite(LED_PIN, Led ? HIGH : LOW);
+  int destino = (cfgActiva == cfgRanura(0)) ? 1 : 0;
+  size_t offset = destino * CFG_TAM_RANURA;
+  int64_t t0 = esp_timer_get_time();
+  if (esp_partition_erase_range(cfgParticion, offset, CFG_TAM_RANURA) != ESP_OK ||
+      esp_partition_write(cfgParticion, offset, &cfgPendiente, sizeof(ConfigBlob)) != ESP_OK ||
+      !cfgEsValida(cfgRanura(destino))) {
+    Serial.println("❌ Falló la escritura de la configuración");
+    cfgHayPendiente = false;
+    return;
+  }
+  int64_t t1 = esp_timer_get_time();
+  cfgActiva = cfgRanura(destino);
+  int64_t t2 = esp_timer_get_time();
+
+  cfgTiempoEscritura = t1 - t0;
+  cfgTiempoConmutacion = t2 - t1;
+  cfgUltimaConmutacion = t2;
+  cfgHayPendiente = false;
+  Serial.printf("Configuración generación %u activa (escritura %lld us, conmutación %lld us)\n",
+                (unsigned) cfgActiva->generacion, cfgTiempoEscritura, cfgTiempoConmutacion);
 }
 
+//----------ID DEL NODO-----------------------------------------
+// Cada placa guarda su id de la trama de grupo en la NVS (espacio "actuador",
+// clave "nodo"), así todas llevan el mismo firmware. Una placa sin id avisa
+// por el puerto serie e ignora las tramas hasta que se le asigne uno.
+Preferences nvs;
+
 /**
- * @brief Enciende o apaga la alarma (representada con 7 segmentos).
+ * @brief Carga el id del nodo desde la NVS.
  */
-void encenderAlarma(){
-  if (Alarma) {
-    digitalWrite(a, HIGH);
-    digitalWrite(b, LOW);
-    digitalWrite(c, LOW);
-    digitalWrite(d, LOW);
-    digitalWrite(e, HIGH);
-    digitalWrite(f, HIGH);
-    digitalWrite(g, HIGH);
+void nodoCargarId() {
+  nvs.begin("actuador", true);
+  uint8_t id = nvs.getUChar("nodo", NODO_SIN_ID);
+  nvs.end();
+  if (id < MAX_ACTUADORES) {
+    nodoId = id;
+    Serial.printf("Nodo de actuadores con id %u\n", (unsigned) nodoId);
   } else {
-    for (int i = 0; i < 7; i++) {
-      digitalWrite(pins[i], LOW);
-    }
+    Serial.println("❌ Placa sin id de nodo: envía \"NODO <id>\" por el puerto serie");
   }
 }
 
 /**
- * @brief Enciende o apaga el aire acondicionado.
+ * @brief Lee líneas "NODO <id>" del puerto serie y guarda el id en la NVS.
  */
-void encenderAire(){
-  digitalWrite(AIRE, Calor ? HIGH : LOW);
+void nodoLeerSerie() {
+  static char linea[16];
+  static size_t n = 0;
+  while (Serial.available() > 0) {
+    char ch = Serial.read();
+    if (ch != '\n' && ch != '\r') {
+      if (n + 1 < sizeof(linea)) {
+        linea[n++] = ch;
+      }
+      continue;
+    }
+    linea[n] = '\0';
+    n = 0;
+    uint8_t id;
+    if (!nodoLeerLinea(linea, &id)) {
+      continue;
+    }
+    nvs.begin("actuador", false);
+    bool guardado = nvs.putUChar("nodo", id) == 1;
+    nvs.end();
+    if (guardado) {
+      nodoId = id;
+      Serial.printf("Id de nodo %u guardado\n", (unsigned) nodoId);
+    } else {
+      Serial.println("❌ No se pudo guardar el id de nodo");
+    }
+  }
 }
 
+/// MAC con la que está registrado el nodo central como peer.
+uint8_t peerNucleoC[6];
+
+ComandoGrupo incomingReadings;
+uint16_t ultimaSecuencia = 0;
+bool haySecuencia = false;
+
+esp_now_peer_info_t peerInfo;
+char macStr[18];
+
 /**
- * @brief Tarea periódica para manejar la bomba.
+ * @brief Agrega un peer al sistema ESP-NOW.
+ * @param mac Dirección MAC del dispositivo a emparejar.
  */
-void tareaBomba(void *parameter) {
-  while (true) {
-    encenderBomba();
-    vTaskDelay(500 / portTICK_PERIOD_MS);
+void addPeer(const uint8_t *mac) {
+  memcpy(peerInfo.peer_addr, mac, 6);
+  peerInfo.channel = 0;
+  peerInfo.encrypt = false;
+
+  if (esp_now_add_peer(&peerInfo) != ESP_OK) {
+    Serial.println("Fallo al agregar peer");
+  } else {
+    memcpy(peerNucleoC, mac, 6);
+    Serial.println("Peer agregado con éxito");
+    snprintf(macStr, sizeof(macStr), "%02X:%02X:%02X:%02X:%02X:%02X",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    Serial.println(macStr);
   }
 }
 
 /**
- * @brief Tarea periódica para manejar el ventilador.
+ * @brief Callback al recibir datos por ESP-NOW.
  */
-void tareaVentilador(void *parameter) {
-  while (true) {
-    encenderVentilador();
-    vTaskDelay(500 / portTICK_PERIOD_MS);
+void OnDataRecv(const esp_now_recv_info_t *info, const uint8_t *incomingData, int len) {
+  if (cfgRecibir(info->src_addr, incomingData, len)) {
+    return;
   }
-}
+  snprintf(macStr, sizeof(macStr), "%02X:%02X:%02X:%02X:%02X:%02X",
+           info->src_addr[0], info->src_addr[1], info->src_addr[2],
+           info->src_addr[3], info->src_addr[4], info->src_addr[5]);
 
-/**
- * @brief Tarea periódica para manejar el LED.
- */
-void tareaLed(void *parameter) {
-  while (true) {
-    encenderLed();
-    vTaskDelay(500 / portTICK_PERIOD_MS);
+  if (memcmp(info->src_addr, cfgActiva->macNucleoC, 6) == 0) {  
+    if (len < (int) offsetof(ComandoGrupo, salidas) || len > (int) sizeof(incomingReadings) ||
+        (incomingData[0] != TIPO_COMANDO_GRUPO && incomingData[0] != TIPO_COMANDO_CRITICO)) {
+      Serial.println("Trama desconocida");
+      return;
+    }
+    memcpy(&incomingReadings, incomingData, len);
+    if (len != (int) offsetof(ComandoGrupo, salidas) + incomingReadings.numNodos ||
+        nodoId >= incomingReadings.numNodos) {
+      Serial.println("Trama de grupo sin datos para este nodo");
+      return;
+    }
+    if (incomingReadings.tipo == TIPO_COMANDO_CRITICO) {
+      alarmaRecibirCritica(incomingReadings);
+      return;
+    }
+    // Descarta duplicados de la misma trama
+    if (haySecuencia && incomingReadings.secuencia == ultimaSecuencia) {
+      return;
+    }
+    haySecuencia = true;
+    ultimaSecuencia = incomingReadings.secuencia;
+
+    uint8_t bits = incomingReadings.salidas[nodoId];
+    Ventilador = bits & SAL_VENTILADOR;
+    Bomba = bits & SAL_BOMBA;
+    Led = bits & SAL_LED;
+    if (!alarmaCanalVigente()) {
+      Alarma = bits & SAL_ALARMA;
+    }
+    Calor = bits & SAL_CALOR;
+
+    Serial.printf("Nodo %d, trama %u: ventilador %d, bomba %d, led %d, alarma %d, aire %d\n",
+                  nodoId, incomingReadings.secuencia, Ventilador, Bomba, Led, Alarma, Calor);
+  } else {
+    Serial.println("MAC desconocida");
   }
 }
 
+//----------PERFILADOR DE TAREAS--------------------------------
+// Cada tarea periódica marca su ciclo y su trabajo (perfil.h); la tarea
+// Perfilador reporta cada periodoPerfilador la ocupación, la pila libre mínima
+// y el periodo real frente al nominal.
+
+PerfilTarea perfilSalidas = perfilNuevo("Salidas", 1000, 500);
+PerfilTarea *perfiles[] = {&perfilSalidas};
+
 /**
- * @brief Tarea periódica para manejar la alarma.
+ * @brief Tarea de baja prioridad que emite el reporte periódico de tareas.
  */
-void tareaAlarma(void *parameter) {
+void tareaPerfilador(void *parameter) {
   while (true) {
-    encenderAlarma();
-    vTaskDelay(500 / portTICK_PERIOD_MS);
+    vTaskDelay(periodoPerfilador / portTICK_PERIOD_MS);
+    Serial.printf("PERFIL t=%lu s, ocupación %s\n", (unsigned long) (millis() / 1000),
+                  PERFIL_CPU_FREERTOS ? "con estadísticas de FreeRTOS" : "por marcas (tiempo de pared)");
+#if PERFIL_CPU_FREERTOS
+    perfilReportarCPU();
+#endif
+    for (size_t i = 0; i < sizeof(perfiles) / sizeof(perfiles[0]); i++) {
+      perfilReportarPeriodo(perfiles[i]);
+    }
   }
 }
 
 /**
- * @brief Tarea periódica para manejar el aire acondicionado.
+ * @brief Tarea de las salidas: cada 500 ms calcula la máscara completa
+ * (salidasCalcular) y la aplica con una sola llamada a salidasActualizar.
+ *
+ * Una trama crítica la despierta al instante. Solo las pasadas por tiempo se
+ * marcan en el perfilador, para que el periodo medido siga siendo el de 500 ms.
  */
-void tareaAire(void *parameter) {
+void tareaSalidas(void *parameter) {
+  PerfilTarea *perfil = (PerfilTarea *) parameter;
+  TickType_t proximo = xTaskGetTickCount();
+  const TickType_t periodo = 500 / portTICK_PERIOD_MS;
   while (true) {
-    encenderAire();
-    vTaskDelay(500 / portTICK_PERIOD_MS);
+    TickType_t ahora = xTaskGetTickCount();
+    if ((int32_t) (ahora - proximo) >= 0) {
+      perfilMarcar(perfil);
+      proximo = ahora + periodo;
+    }
+    perfilInicioTrabajo(perfil);
+    salidasAplicar();
+    perfilFinTrabajo(perfil);
+    int32_t espera = (int32_t) (proximo - xTaskGetTickCount());
+    ulTaskNotifyTake(pdTRUE, espera > 0 ? espera : 0);
   }
 }
 
@@ -214,6 +347,8 @@ void tareaAire(void *parameter) {
  */
 void setup(){
   Serial.begin(115200);
+  cfgIniciar();
+  nodoCargarId();
   WiFi.mode(WIFI_STA);
 
   if (esp_now_init() != ESP_OK) {
@@ -221,7 +356,7 @@ void setup(){
     return;
   }
 
-  addPeer(macNucleoC);
+  addPeer(cfgActiva->macNucleoC);
   esp_now_register_recv_cb(OnDataRecv);
 
   pinMode(RELAY_BOMBA, OUTPUT);
@@ -233,17 +368,36 @@ void setup(){
     pinMode(pins[i], OUTPUT);
   }
 
-  digitalWrite(RELAY_BOMBA, HIGH);
-  digitalWrite(RELAY_VENTILADOR, HIGH);
+  // Todo apagado hasta la primera trama (relés activos en bajo en HIGH)
+  salidasIniciar(MASCARA_SALIDAS, salidasCalcular());
 
-  xTaskCreatePinnedToCore(tareaBomba, "Bomba", 1000, NULL, 1, NULL, 1);
-  xTaskCreatePinnedToCore(tareaVentilador, "Ventilador", 1000, NULL, 1, NULL, 1);
-  xTaskCreatePinnedToCore(tareaLed, "Led", 1000, NULL, 1, NULL, 1);
-  xTaskCreatePinnedToCore(tareaAlarma, "Alarma", 1000, NULL, 1, NULL, 1);
-  xTaskCreatePinnedToCore(tareaAire, "Aire", 1000, NULL, 1, NULL, 1);
+  // Prioridad 2: al despertarla una trama crítica se adelanta a las demás tareas
+  xTaskCreatePinnedToCore(tareaSalidas, "Salidas", perfilSalidas.pila, &perfilSalidas, 2, &perfilSalidas.tarea, 1);
+  SalidasTask = perfilSalidas.tarea;
+  xTaskCreatePinnedToCore(tareaPerfilador, "Perfilador", 3072, NULL, 1, NULL, 0);
 }
 
 /**
- * @brief Bucle principal (vacío, ya que todo se ejecuta con FreeRTOS).
+ * @brief Bucle principal. Las salidas las maneja tareaSalidas; aquí se
+ * atiende el comando NODO, se aplica una configuración recibida, se actualiza
+ * el peer y se reporta cada minuto la actividad del puerto de salidas.
  */
-void loop(){}
\ No newline at end of file
+void loop(){
+  nodoLeerSerie();
+  cfgAplicarPendiente();
+  if (memcmp(peerNucleoC, cfgActiva->macNucleoC, 6) != 0) {
+    esp_now_del_peer(peerNucleoC);
+    addPeer(cfgActiva->macNucleoC);
+  }
+
+  static uint32_t ultimoReporte = 0;
+  if (millis() - ultimoReporte >= 60000) {
+    ultimoReporte = millis();
+    Serial.printf("Salidas: %u escrituras de registro, %u actualizaciones sin cambios\n",
+                  (unsigned) salidasEscrituras, (unsigned) salidasOmitidas);
+    Serial.printf("Alarma crítica: %u tramas, recepción a salida %lld us (máx %lld us), canal %s\n",
+                  (unsigned) alarmaTramasCriticas, alarmaLatenciaUs, alarmaLatenciaMaxUs,
+                  alarmaCanalVigente() ? "vigente" : "sin tramas");
+  }
+  vTaskDelay(500 / portTICK_PERIOD_MS);
+}
\ No newline at end of file
@@ -0,0 +1,162 @@
+/**
+ * @file comandos.h
+ * @brief Tramas de comandos del nodo central, estado de las salidas y canal de alarma crítica.
+ *
+ * Sin radio: OnDataRecv (en el sketch) valida origen y longitud y entrega aquí
+ * las tramas, así las pruebas del PC recorren el mismo camino hasta el puerto
+ * de salidas.
+ */
+#ifndef ACTUADORES_COMANDOS_H
+#define ACTUADORES_COMANDOS_H
+
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "puerto_salidas.h"
+
+// Variables de estado: las escriben las tramas y las aplica tareaSalidas
+inline bool Ventilador = false;
+inline bool Bomba = false;
+inline bool Led = false;
+inline bool Alarma = false;
+inline bool Calor = false;
+
+/// Valor de nodoId mientras la placa no tenga id asignado.
+#define NODO_SIN_ID 0xFF
+
+#define TIPO_COMANDO_GRUPO 0xA5
+#define MAX_ACTUADORES 64
+
+// Bits de cada byte de salidas
+#define SAL_VENTILADOR (1 << 0)
+#define SAL_BOMBA      (1 << 1)
+#define SAL_LED        (1 << 2)
+#define SAL_ALARMA     (1 << 3)
+#define SAL_CALOR      (1 << 4)
+
+/// Id de este nodo dentro de la trama de grupo (0..NUM_ACTUADORES-1 del nodo
+/// central). Es propio de cada placa: se lee de la NVS al arrancar y se fija
+/// por el puerto serie con "NODO <id>" (ver nodoLeerLinea).
+inline uint8_t nodoId = NODO_SIN_ID;
+
+/**
+ * @brief Trama de comandos de grupo enviada por broadcast desde el nodo central.
+ *
+ * Llegan solo los primeros numNodos bytes de salidas.
+ */
+typedef struct __attribute__((packed)) ComandoGrupo {
+  uint8_t tipo;                     ///< TIPO_COMANDO_GRUPO
+  uint8_t numNodos;                 ///< Entradas válidas en salidas[]
+  uint16_t secuencia;               ///< Crece con cada trama
+  uint8_t salidas[MAX_ACTUADORES];  ///< Bits SAL_* por id de nodo
+} ComandoGrupo;
+
+/**
+ * @brief Lee una línea "NODO <id>" del puerto serie.
+ * @return false si la línea no es un comando NODO o el id no cabe en la trama.
+ */
+inline bool nodoLeerLinea(const char *linea, uint8_t *id) {
+  unsigned v;
+  char resto;
+  if (sscanf(linea, "NODO %u%c", &v, &resto) != 1 || v >= MAX_ACTUADORES) {
+    return false;
+  }
+  *id = (uint8_t) v;
+  return true;
+}
+
+//----------CANAL DE ALARMA CRITICA-----------------------------
+// Las tramas TIPO_COMANDO_CRITICO tienen el formato de grupo, secuencia
+// propia y solo el bit SAL_ALARMA. Enclavan la alarma: mientras se haya oído
+// el canal crítico en los últimos caducidadCritica ms, las tramas normales
+// no pueden cambiarla (una trama normal atrasada no apaga una alarma recién
+// activada). Cada cambio despierta a tareaSalidas sin esperar su periodo.
+#define TIPO_COMANDO_CRITICO 0xA6
+
+static const uint32_t caducidadCritica = 5000;  // ms sin tramas críticas antes de volver a las normales
+
+inline TaskHandle_t SalidasTask = NULL;
+inline volatile bool alarmaEnclavada = false;      // El canal crítico manda sobre la alarma
+inline volatile uint32_t alarmaCriticaMarca = 0;   // millis() de la última trama crítica
+inline volatile int64_t alarmaRecepcionUs = 0;     // esp_timer_get_time() del último cambio recibido
+inline volatile bool alarmaCambio = false;         // Cambio aún no aplicado a las salidas
+inline uint16_t ultimaSecuenciaCritica = 0;
+inline bool haySecuenciaCritica = false;
+
+// Mediciones
+inline uint32_t alarmaTramasCriticas = 0;
+inline int64_t alarmaLatenciaUs = 0;      // Recepción a salida, último cambio
+inline int64_t alarmaLatenciaMaxUs = 0;
+
+/**
+ * @brief Indica si el canal crítico sigue mandando sobre la alarma.
+ */
+inline bool alarmaCanalVigente() {
+  return alarmaEnclavada && millis() - alarmaCriticaMarca < caducidadCritica;
+}
+
+/**
+ * @brief Aplica una trama crítica ya validada.
+ */
+inline void alarmaRecibirCritica(const ComandoGrupo &c) {
+  alarmaCriticaMarca = millis();
+  alarmaEnclavada = true;
+  // Las copias de reintento llevan la misma secuencia
+  if (haySecuenciaCritica && c.secuencia == ultimaSecuenciaCritica) {
+    return;
+  }
+  haySecuenciaCritica = true;
+  ultimaSecuenciaCritica = c.secuencia;
+  alarmaTramasCriticas++;
+  bool nueva = c.salidas[nodoId] & SAL_ALARMA;
+  if (nueva != Alarma) {
+    alarmaRecepcionUs = esp_timer_get_time();
+    Alarma = nueva;
+    alarmaCambio = true;
+    if (SalidasTask != NULL) {
+      xTaskNotifyGive(SalidasTask);
+    }
+  }
+}
+
+/**
+ * @brief Niveles de todas las salidas (MASCARA_SALIDAS) según las variables de estado.
+ *
+ * Los relés de bomba y ventilador son activos en bajo; la alarma se
+ * representa con PATRON_ALARMA en los 7 segmentos.
+ */
+inline uint64_t salidasCalcular() {
+  uint64_t niveles = 0;
+  if (!Ventilador) {
+    niveles |= BIT_PIN(RELAY_VENTILADOR);
+  }
+  if (!Bomba) {
+    niveles |= BIT_PIN(RELAY_BOMBA);
+  }
+  if (Led) {
+    niveles |= BIT_PIN(LED_PIN);
+  }
+  if (Calor) {
+    niveles |= BIT_PIN(AIRE);
+  }
+  if (Alarma) {
+    niveles |= PATRON_ALARMA;
+  }
+  return niveles;
+}
+
+/**
+ * @brief Lleva el estado de todas las salidas al puerto en una sola
+ * actualización y mide la latencia del último cambio de alarma.
+ */
+inline void salidasAplicar() {
+  salidasActualizar(MASCARA_SALIDAS, salidasCalcular());
+  if (alarmaCambio) {
+    alarmaCambio = false;
+    alarmaLatenciaUs = esp_timer_get_time() - alarmaRecepcionUs;
+    if (alarmaLatenciaUs > alarmaLatenciaMaxUs) {
+      alarmaLatenciaMaxUs = alarmaLatenciaUs;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,99 @@
+/**
+ * @file puerto_salidas.h
+ * @brief Pines del nodo de actuadores y puerto de salidas por registros set/clear.
+ *
+ * Todas las escrituras a registros pasan por SALIDAS_ESCRIBIR_REGISTRO; las
+ * pruebas del PC la definen antes de incluir este archivo para contarlas.
+ */
+#ifndef ACTUADORES_PUERTO_SALIDAS_H
+#define ACTUADORES_PUERTO_SALIDAS_H
+
+#include <Arduino.h>
+#include "soc/gpio_reg.h"
+
+#ifndef SALIDAS_ESCRIBIR_REGISTRO
+#define SALIDAS_ESCRIBIR_REGISTRO(reg, valor) REG_WRITE((reg), (valor))
+#endif
+
+#define RELAY_BOMBA 21
+#define RELAY_VENTILADOR 22
+#define LED_PIN 18
+#define AIRE 17
+
+const int a = 13, b = 12, c = 14, d = 27, e = 26, f = 25, g = 33;
+const int pins[] = {a, b, c, d, e, f, g};
+
+//----------PUERTO DE SALIDAS-----------------------------------
+// Todas las salidas se guardan en una máscara de 64 bits (bit n = GPIO n) y se
+// escriben con los registros de set/clear del ESP32, solo los bits que cambian.
+#define BIT_PIN(p) (1ULL << (p))
+
+const uint64_t MASCARA_SEGMENTOS = BIT_PIN(a) | BIT_PIN(b) | BIT_PIN(c) | BIT_PIN(d) |
+                                   BIT_PIN(e) | BIT_PIN(f) | BIT_PIN(g);
+/// Segmentos encendidos cuando hay alarma de fuego (a, e, f, g).
+const uint64_t PATRON_ALARMA = BIT_PIN(a) | BIT_PIN(e) | BIT_PIN(f) | BIT_PIN(g);
+/// Todas las salidas del nodo: relés, LED, aire y segmentos.
+const uint64_t MASCARA_SALIDAS = BIT_PIN(RELAY_BOMBA) | BIT_PIN(RELAY_VENTILADOR) | BIT_PIN(LED_PIN) |
+                                 BIT_PIN(AIRE) | MASCARA_SEGMENTOS;
+
+inline uint64_t salidasActual = 0;          // Niveles escritos en los registros
+inline portMUX_TYPE salidasMux = portMUX_INITIALIZER_UNLOCKED;
+inline uint32_t salidasEscrituras = 0;      // Escrituras a registros
+inline uint32_t salidasOmitidas = 0;        // Actualizaciones sin cambios
+
+/**
+ * @brief Escribe en los registros W1TS/W1TC los bits a poner en alto y en bajo.
+ *
+ * GPIO 0-31 están en el banco 0 y GPIO 32-39 en el banco 1; un banco sin
+ * cambios no se toca.
+ */
+inline void salidasEscribir(uint64_t poner, uint64_t quitar) {
+  if ((uint32_t) poner) {
+    SALIDAS_ESCRIBIR_REGISTRO(GPIO_OUT_W1TS_REG, (uint32_t) poner);
+    salidasEscrituras++;
+  }
+  if ((uint32_t) quitar) {
+    SALIDAS_ESCRIBIR_REGISTRO(GPIO_OUT_W1TC_REG, (uint32_t) quitar);
+    salidasEscrituras++;
+  }
+  if ((uint32_t) (poner >> 32)) {
+    SALIDAS_ESCRIBIR_REGISTRO(GPIO_OUT1_W1TS_REG, (uint32_t) (poner >> 32));
+    salidasEscrituras++;
+  }
+  if ((uint32_t) (quitar >> 32)) {
+    SALIDAS_ESCRIBIR_REGISTRO(GPIO_OUT1_W1TC_REG, (uint32_t) (quitar >> 32));
+    salidasEscrituras++;
+  }
+}
+
+/**
+ * @brief Fija todas las salidas gestionadas a un estado conocido.
+ * @param gestionadas Pines controlados por el puerto.
+ * @param niveles Nivel inicial (bit en 1 = HIGH).
+ */
+inline void salidasIniciar(uint64_t gestionadas, uint64_t niveles) {
+  portENTER_CRITICAL(&salidasMux);
+  salidasEscribir(niveles & gestionadas, ~niveles & gestionadas);
+  salidasActual = niveles & gestionadas;
+  portEXIT_CRITICAL(&salidasMux);
+}
+
+/**
+ * @brief Actualiza un grupo de salidas escribiendo solo los bits que cambian.
+ * @param grupo Pines que controla quien llama.
+ * @param niveles Nivel deseado para esos pines (bit en 1 = HIGH).
+ */
+inline void salidasActualizar(uint64_t grupo, uint64_t niveles) {
+  portENTER_CRITICAL(&salidasMux);
+  uint64_t deseado = (salidasActual & ~grupo) | (niveles & grupo);
+  uint64_t cambios = deseado ^ salidasActual;
+  if (cambios) {
+    salidasEscribir(cambios & deseado, cambios & ~deseado);
+    salidasActual = deseado;
+  } else {
+    salidasOmitidas++;
+  }
+  portEXIT_CRITICAL(&salidasMux);
+}
+
+#endif
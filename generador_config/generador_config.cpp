@@ -0,0 +1,141 @@
+/**
+ * @file generador_config.cpp
+ * @brief Genera en Linux una configuración firmada (ConfigBlob) para el invernadero.
+ *
+ * Parte de los valores de compilación (cfgPorDefecto), aplica las opciones,
+ * calcula CRC y firma con la misma cabecera config_blob.h que los nodos y
+ * escribe la línea "CFG <hex>" que lee el nodo central por el puerto serie.
+ * El nodo central la guarda en flash y la reenvía a sensores y actuadores.
+ *
+ * Compilación (o con el CMakeLists.txt de la raíz):
+ *   g++ -O2 -std=c++17 -DCFG_CLAVE=\"...\" generador_config.cpp -o generador_config -lz -lcrypto
+ *
+ * Uso:
+ *   generador_config --generacion N [opciones] > /dev/ttyUSB0
+ *
+ * Opciones:
+ *   --generacion N          Obligatoria; mayor que la activa en los nodos
+ *   --sensores MAC          Nodo de sensores (AA:BB:CC:DD:EE:FF)
+ *   --actuadores MAC        Nodo de actuadores
+ *   --central MAC           Nodo central
+ *   --temp-max C  --temp-min C  --hum-max %  --co2-max ppm
+ *   --lum-alarma ADC  --lum-led ADC  --suelo-min %
+ *   --clave TEXTO           Clave de la firma (por defecto la variable de
+ *                           entorno INVERNADERO_CFG_CLAVE o la de compilación,
+ *                           CFG_CLAVE)
+ *   --binario ARCHIVO       Escribe además el blob en binario
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../prueba_3_corete/config_blob.h"
+
+/**
+ * @brief Lee una MAC "AA:BB:CC:DD:EE:FF".
+ */
+static bool leerMAC(const char *texto, uint8_t mac[6]) {
+  unsigned v[6];
+  char resto;
+  if (sscanf(texto, "%x:%x:%x:%x:%x:%x%c", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &resto) != 6) {
+    return false;
+  }
+  for (int i = 0; i < 6; i++) {
+    if (v[i] > 0xFF) {
+      return false;
+    }
+    mac[i] = (uint8_t) v[i];
+  }
+  return true;
+}
+
+/**
+ * @brief Lee un número con strtod; falla si sobra texto.
+ */
+static bool leerNumero(const char *texto, double *v) {
+  char *fin;
+  *v = strtod(texto, &fin);
+  return fin != texto && *fin == '\0';
+}
+
+int main(int argc, char **argv) {
+  ConfigBlob cfg = cfgPorDefecto;
+  const char *clave = getenv("INVERNADERO_CFG_CLAVE");
+  const char *binario = NULL;
+  bool conGeneracion = false;
+
+  for (int i = 1; i < argc; i++) {
+    const char *opcion = argv[i];
+    if (i + 1 >= argc) {
+      fprintf(stderr, "Falta el valor de %s\n", opcion);
+      return 2;
+    }
+    const char *valor = argv[++i];
+    double v = 0;
+    bool ok = true;
+    if (strcmp(opcion, "--sensores") == 0) {
+      ok = leerMAC(valor, cfg.macSensores);
+    } else if (strcmp(opcion, "--actuadores") == 0) {
+      ok = leerMAC(valor, cfg.macActuadores);
+    } else if (strcmp(opcion, "--central") == 0) {
+      ok = leerMAC(valor, cfg.macNucleoC);
+    } else if (strcmp(opcion, "--clave") == 0) {
+      clave = valor;
+    } else if (strcmp(opcion, "--binario") == 0) {
+      binario = valor;
+    } else if (!leerNumero(valor, &v)) {
+      ok = false;
+    } else if (strcmp(opcion, "--generacion") == 0) {
+      ok = v >= 1 && v <= UINT32_MAX;
+      cfg.generacion = (uint32_t) v;
+      conGeneracion = true;
+    } else if (strcmp(opcion, "--temp-max") == 0) {
+      cfg.tempMax = v;
+    } else if (strcmp(opcion, "--temp-min") == 0) {
+      cfg.tempMin = v;
+    } else if (strcmp(opcion, "--hum-max") == 0) {
+      cfg.humMax = v;
+    } else if (strcmp(opcion, "--co2-max") == 0) {
+      cfg.co2Max = v;
+    } else if (strcmp(opcion, "--lum-alarma") == 0) {
+      ok = v >= 0 && v <= 4095;
+      cfg.lumAlarma = (uint16_t) v;
+    } else if (strcmp(opcion, "--lum-led") == 0) {
+      ok = v >= 0 && v <= 4095;
+      cfg.lumLed = (uint16_t) v;
+    } else if (strcmp(opcion, "--suelo-min") == 0) {
+      cfg.humSueloMin = v;
+    } else {
+      fprintf(stderr, "Opción desconocida: %s\n", opcion);
+      return 2;
+    }
+    if (!ok) {
+      fprintf(stderr, "Valor incorrecto para %s: %s\n", opcion, valor);
+      return 2;
+    }
+  }
+  if (!conGeneracion) {
+    fprintf(stderr, "Uso: %s --generacion N [opciones]  (ver cabecera del código)\n", argv[0]);
+    return 2;
+  }
+  if (cfg.tempMin >= cfg.tempMax || cfg.lumLed >= cfg.lumAlarma) {
+    fprintf(stderr, "Umbrales incoherentes: temp-min < temp-max y lum-led < lum-alarma\n");
+    return 2;
+  }
+
+  cfgFirmar(&cfg, clave != NULL ? clave : CFG_CLAVE);
+
+  char hex[2 * sizeof(ConfigBlob) + 1];
+  cfgAHex(&cfg, hex, sizeof(hex));
+  printf("CFG %s\n", hex);
+
+  if (binario != NULL) {
+    FILE *f = fopen(binario, "wb");
+    if (f == NULL || fwrite(&cfg, sizeof(cfg), 1, f) != 1 || fclose(f) != 0) {
+      perror(binario);
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,649 @@
+/**
+ * @file importador_csv.cpp
+ * @brief Importador en Linux del histórico CSV de la tarjeta SD del nodo central.
+ *
+ * Recorre el árbol /YYYY-MM-DD/HH/data.csv escrito por logSensorData y los
+ * /YYYY-MM-DD/data.csv de los días ya compactados en el nodo central, procesa
+ * los días en paralelo (mmap y parseo sin reservas de memoria por línea) y
+ * genera un archivo columnar ordenado por tiempo por cada campo, más un
+ * índice de bloques.
+ *
+ * Un día puede tener a la vez data.csv y carpetas de hora: una hora que llegó
+ * tarde, una compactación que falló o una que se cortó antes de borrar las
+ * horas. Por eso cada día se une entero antes de escribirlo: las horas que
+ * data.csv ya resume ("# resumen") no se leen, como hace el compactador, las
+ * filas se ordenan por tiempo y las repetidas se descartan.
+ *
+ * Compilación:
+ *   g++ -O2 -std=c++17 -pthread importador_csv.cpp -o importador_csv
+ *
+ * Uso:
+ *   importador_csv <raiz_sd> <dir_salida> [-j hilos] [--escalado]
+ *
+ * Salida en dir_salida:
+ * - timestamp.col, nodeId.col, rssi.col, temp.col, hum.col, light.col,
+ *   co2ppm.col, soilMoisture.col: cabecera ArchivoColumna y después los
+ *   valores en bruto, una fila por lectura y en el mismo orden en todos.
+ * - nodeId.dict: nombres de nodo, uno por línea; nodeId.col guarda el índice.
+ * - bloques.idx: cabecera ArchivoColumna (tipo TIPO_BLOQUE) y un Bloque por
+ *   cada FILAS_POR_BLOQUE filas, con su rango de tiempo.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cctype>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static const uint32_t FILAS_POR_BLOQUE = 65536;
+
+// Tipos de columna
+enum : uint32_t {
+  TIPO_INT64 = 0,
+  TIPO_UINT16 = 1,
+  TIPO_INT16 = 2,
+  TIPO_FLOAT32 = 3,
+  TIPO_BLOQUE = 4
+};
+
+/**
+ * @brief Cabecera de cada archivo .col y de bloques.idx.
+ */
+struct ArchivoColumna {
+  char magic[8];            ///< "INVCOL1"
+  uint32_t tipo;            ///< TIPO_*
+  uint32_t filasPorBloque;  ///< FILAS_POR_BLOQUE
+  uint64_t filas;           ///< Número de valores que siguen
+};
+
+/**
+ * @brief Entrada del índice de bloques.
+ */
+struct Bloque {
+  uint64_t primeraFila;
+  int64_t tsMin;
+  int64_t tsMax;
+};
+
+/**
+ * @brief Columnas de un archivo CSV ya parseado.
+ */
+struct Columnas {
+  std::vector<int64_t> ts;
+  std::vector<uint16_t> nodo;
+  std::vector<int16_t> rssi;
+  std::vector<float> temp;
+  std::vector<float> hum;
+  std::vector<uint16_t> luz;
+  std::vector<float> co2;
+  std::vector<float> suelo;
+
+  size_t filas() const { return ts.size(); }
+
+  void reservar(size_t n) {
+    ts.reserve(n); nodo.reserve(n); rssi.reserve(n); temp.reserve(n);
+    hum.reserve(n); luz.reserve(n); co2.reserve(n); suelo.reserve(n);
+  }
+
+  void liberar() { *this = Columnas(); }
+};
+
+//----------DICCIONARIO DE NODOS--------------------------------
+std::mutex nodosMutex;
+std::vector<std::string> nodos;
+
+/**
+ * @brief Índice de un nombre de nodo; solo reserva memoria si es nuevo.
+ */
+uint16_t indiceNodo(const char *p, size_t n) {
+  std::lock_guard<std::mutex> lock(nodosMutex);
+  for (size_t i = 0; i < nodos.size(); i++) {
+    if (nodos[i].size() == n && memcmp(nodos[i].data(), p, n) == 0) {
+      return (uint16_t) i;
+    }
+  }
+  nodos.emplace_back(p, n);
+  return (uint16_t) (nodos.size() - 1);
+}
+
+//----------PARSEO---------------------------------------------
+/**
+ * @brief Días desde 1970-01-01 de una fecha civil (algoritmo de H. Hinnant).
+ */
+int64_t diasDesdeCivil(int64_t y, unsigned m, unsigned d) {
+  y -= m <= 2;
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = (unsigned) (y - era * 400);
+  const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int64_t) doe - 719468;
+}
+
+static inline bool digitos(const char *p, int n, unsigned &v) {
+  v = 0;
+  for (int i = 0; i < n; i++) {
+    unsigned c = (unsigned char) p[i] - '0';
+    if (c > 9) {
+      return false;
+    }
+    v = v * 10 + c;
+  }
+  return true;
+}
+
+/**
+ * @brief Convierte "YYYY-MM-DD hh:mm:ss" en segundos unix.
+ */
+bool parsearTimestamp(const char *p, const char *fin, int64_t &ts) {
+  if (fin - p != 19 || p[4] != '-' || p[7] != '-' || p[10] != ' ' || p[13] != ':' || p[16] != ':') {
+    return false;
+  }
+  unsigned y, mo, d, h, mi, s;
+  if (!digitos(p, 4, y) || !digitos(p + 5, 2, mo) || !digitos(p + 8, 2, d) ||
+      !digitos(p + 11, 2, h) || !digitos(p + 14, 2, mi) || !digitos(p + 17, 2, s)) {
+    return false;
+  }
+  ts = diasDesdeCivil(y, mo, d) * 86400 + h * 3600 + mi * 60 + s;
+  return true;
+}
+
+/**
+ * @brief Devuelve el final del campo que empieza en p (',' o fin de línea).
+ */
+static inline const char *finCampo(const char *p, const char *finLinea) {
+  const char *c = (const char *) memchr(p, ',', finLinea - p);
+  return c ? c : finLinea;
+}
+
+template <typename T>
+static inline bool numero(const char *p, const char *fin, T &v) {
+  auto r = std::from_chars(p, fin, v);
+  return r.ec == std::errc() && r.ptr == fin;
+}
+
+/**
+ * @brief Parsea una línea de datos y la agrega a las columnas.
+ *
+ * Formato: timestamp,nodeId,rssi,temp,hum,light,co2ppm,soilMoisture
+ * @return false si la línea no tiene ese formato (por ejemplo, la cabecera).
+ */
+bool parsearLinea(const char *p, const char *fin, Columnas &c, const char *&nodoCache,
+                  size_t &nodoCacheLen, uint16_t &nodoCacheIdx) {
+  const char *f[8][2];
+  for (int i = 0; i < 8; i++) {
+    if (p > fin) {
+      return false;
+    }
+    const char *e = finCampo(p, fin);
+    f[i][0] = p;
+    f[i][1] = e;
+    p = e + 1;
+  }
+  if (p <= fin) {
+    return false;  // sobran campos
+  }
+
+  int64_t ts;
+  int rssi;
+  float temp, hum, co2, suelo;
+  unsigned luz;
+  if (!parsearTimestamp(f[0][0], f[0][1], ts) || !numero(f[2][0], f[2][1], rssi) ||
+      !numero(f[3][0], f[3][1], temp) || !numero(f[4][0], f[4][1], hum) ||
+      !numero(f[5][0], f[5][1], luz) || !numero(f[6][0], f[6][1], co2) ||
+      !numero(f[7][0], f[7][1], suelo)) {
+    return false;
+  }
+
+  size_t nodoLen = f[1][1] - f[1][0];
+  if (nodoCache == NULL || nodoLen != nodoCacheLen || memcmp(nodoCache, f[1][0], nodoLen) != 0) {
+    nodoCacheIdx = indiceNodo(f[1][0], nodoLen);
+    nodoCache = f[1][0];
+    nodoCacheLen = nodoLen;
+  }
+
+  c.ts.push_back(ts);
+  c.nodo.push_back(nodoCacheIdx);
+  c.rssi.push_back((int16_t) rssi);
+  c.temp.push_back(temp);
+  c.hum.push_back(hum);
+  c.luz.push_back((uint16_t) luz);
+  c.co2.push_back(co2);
+  c.suelo.push_back(suelo);
+  return true;
+}
+
+template <typename T>
+static void reordenar(std::vector<T> &v, const std::vector<uint32_t> &orden) {
+  std::vector<T> r(v.size());
+  for (size_t i = 0; i < orden.size(); i++) {
+    r[i] = v[orden[i]];
+  }
+  v.swap(r);
+}
+
+/**
+ * @brief Ordena las filas por tiempo si el día no venía ordenado.
+ */
+void ordenarSiHaceFalta(Columnas &c) {
+  if (std::is_sorted(c.ts.begin(), c.ts.end())) {
+    return;
+  }
+  std::vector<uint32_t> orden(c.filas());
+  for (size_t i = 0; i < orden.size(); i++) {
+    orden[i] = (uint32_t) i;
+  }
+  std::stable_sort(orden.begin(), orden.end(),
+                   [&](uint32_t a, uint32_t b) { return c.ts[a] < c.ts[b]; });
+  reordenar(c.ts, orden); reordenar(c.nodo, orden); reordenar(c.rssi, orden);
+  reordenar(c.temp, orden); reordenar(c.hum, orden); reordenar(c.luz, orden);
+  reordenar(c.co2, orden); reordenar(c.suelo, orden);
+}
+
+/**
+ * @brief Descarta las filas repetidas de columnas ya ordenadas por tiempo.
+ * @return Filas descartadas.
+ *
+ * Solo se comparan las filas con el mismo tiempo, que son pocas.
+ */
+uint64_t quitarDuplicadas(Columnas &c) {
+  size_t n = 0;
+  size_t inicioTs = 0;  // Primera fila conservada con el tiempo de la actual
+  for (size_t i = 0; i < c.filas(); i++) {
+    if (n > 0 && c.ts[i] != c.ts[n - 1]) {
+      inicioTs = n;
+    }
+    bool repetida = false;
+    for (size_t j = inicioTs; j < n && !repetida; j++) {
+      repetida = c.nodo[j] == c.nodo[i] && c.rssi[j] == c.rssi[i] && c.temp[j] == c.temp[i] &&
+                 c.hum[j] == c.hum[i] && c.luz[j] == c.luz[i] && c.co2[j] == c.co2[i] &&
+                 c.suelo[j] == c.suelo[i];
+    }
+    if (repetida) {
+      continue;
+    }
+    c.ts[n] = c.ts[i]; c.nodo[n] = c.nodo[i]; c.rssi[n] = c.rssi[i]; c.temp[n] = c.temp[i];
+    c.hum[n] = c.hum[i]; c.luz[n] = c.luz[i]; c.co2[n] = c.co2[i]; c.suelo[n] = c.suelo[i];
+    n++;
+  }
+  uint64_t descartadas = c.filas() - n;
+  c.ts.resize(n); c.nodo.resize(n); c.rssi.resize(n); c.temp.resize(n);
+  c.hum.resize(n); c.luz.resize(n); c.co2.resize(n); c.suelo.resize(n);
+  return descartadas;
+}
+
+/**
+ * @brief Mapea un archivo CSV y agrega todas sus líneas a las columnas.
+ * @param invalidas Se incrementa con cada línea descartada (sin contar la
+ * cabecera ni las líneas de comentario "#" de los archivos compactados).
+ * @param horasResumidas Bit h: el archivo trae la línea "# resumen" de la hora h.
+ */
+bool parsearArchivo(const std::string &ruta, Columnas &c, uint64_t &invalidas, uint32_t &horasResumidas) {
+  int fd = open(ruta.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+  if (st.st_size == 0) {
+    close(fd);
+    return true;
+  }
+  void *mapa = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapa == MAP_FAILED) {
+    return false;
+  }
+  madvise(mapa, st.st_size, MADV_SEQUENTIAL);
+
+  const char *p = (const char *) mapa;
+  const char *fin = p + st.st_size;
+  c.reservar(c.filas() + st.st_size / 48 + 1);  // Una línea típica ocupa unos 50 bytes
+
+  const char *nodoCache = NULL;
+  size_t nodoCacheLen = 0;
+  uint16_t nodoCacheIdx = 0;
+  bool primera = true;
+  while (p < fin) {
+    const char *nl = (const char *) memchr(p, '\n', fin - p);
+    const char *finLinea = nl ? nl : fin;
+    const char *e = finLinea;
+    if (e > p && e[-1] == '\r') {
+      e--;
+    }
+    // "# resumen YYYY-MM-DD HH ..." (el mapa no termina en '\0': sin sscanf)
+    unsigned h;
+    if (e - p >= 23 && memcmp(p, "# resumen ", 10) == 0 && p[20] == ' ' && digitos(p + 21, 2, h) && h < 24) {
+      horasResumidas |= 1UL << h;
+    } else if (e > p && *p != '#' && !parsearLinea(p, e, c, nodoCache, nodoCacheLen, nodoCacheIdx) &&
+               !(primera && *p == 't')) {
+      invalidas++;
+    }
+    primera = primera && (e == p || *p == '#');
+    p = finLinea + 1;
+  }
+  // nodoCache apunta al mapa; no se usa después de liberarlo
+  munmap(mapa, st.st_size);
+  return true;
+}
+
+//----------RECORRIDO------------------------------------------
+/**
+ * @brief Archivos de un día: su data.csv compactado (si lo hay) y sus horas sueltas.
+ */
+struct Dia {
+  std::string compactado;
+  std::vector<std::string> horas;  ///< HH/data.csv, en orden de hora
+};
+
+/**
+ * @brief Lista los días con datos (data.csv de hora o de día compactado), en orden temporal.
+ */
+std::vector<Dia> buscarDias(const fs::path &raiz) {
+  std::vector<std::pair<std::string, std::string>> archivos;  // (carpeta del día, ruta)
+  std::error_code ec;
+  for (auto it = fs::recursive_directory_iterator(raiz, ec); !ec && it != fs::recursive_directory_iterator();
+       it.increment(ec)) {
+    if (it->is_regular_file() && it->path().filename() == "data.csv") {
+      fs::path carpeta = it->path().parent_path();
+      std::string nombre = carpeta.filename().string();
+      bool hora = nombre.size() == 2 && isdigit((unsigned char) nombre[0]) && isdigit((unsigned char) nombre[1]);
+      archivos.emplace_back((hora ? carpeta.parent_path() : carpeta).string(), it->path().string());
+    }
+  }
+  // Con nombres de ancho fijo, el orden lexicográfico de los días es el
+  // temporal; dentro de cada día "HH/data.csv" va antes que "data.csv"
+  std::sort(archivos.begin(), archivos.end());
+  std::vector<Dia> dias;
+  for (size_t i = 0; i < archivos.size(); i++) {
+    if (i == 0 || archivos[i].first != archivos[i - 1].first) {
+      dias.emplace_back();
+    }
+    fs::path ruta(archivos[i].second);
+    if (ruta.parent_path().string() == archivos[i].first) {
+      dias.back().compactado = archivos[i].second;
+    } else {
+      dias.back().horas.push_back(archivos[i].second);
+    }
+  }
+  return dias;
+}
+
+/**
+ * @brief Une los archivos de un día en columnas ordenadas por tiempo y sin filas repetidas.
+ * @param fallidos Se incrementa con cada archivo que no se pudo leer.
+ * @param duplicadas Se incrementa con cada fila repetida descartada.
+ */
+void parsearDia(const Dia &d, Columnas &c, uint64_t &invalidas, uint64_t &fallidos, uint64_t &duplicadas) {
+  uint32_t horasResumidas = 0;
+  if (!d.compactado.empty() && !parsearArchivo(d.compactado, c, invalidas, horasResumidas)) {
+    fallidos++;
+  }
+  for (const std::string &ruta : d.horas) {
+    // Hora ya incluida en data.csv: la compactación se cortó antes de borrarla
+    int h = atoi(fs::path(ruta).parent_path().filename().c_str());
+    uint32_t resumidasHora = 0;
+    if (!(horasResumidas & (1UL << h)) && !parsearArchivo(ruta, c, invalidas, resumidasHora)) {
+      fallidos++;
+    }
+  }
+  ordenarSiHaceFalta(c);
+  duplicadas += quitarDuplicadas(c);
+}
+
+//----------ESCRITURA-----------------------------------------
+/**
+ * @brief Archivo de salida de una columna.
+ */
+struct SalidaColumna {
+  FILE *f = NULL;
+  uint64_t filas = 0;
+  std::vector<char> buffer;
+
+  bool abrir(const fs::path &ruta, uint32_t tipo) {
+    f = fopen(ruta.c_str(), "wb");
+    if (!f) {
+      return false;
+    }
+    buffer.resize(1 << 20);
+    setvbuf(f, buffer.data(), _IOFBF, buffer.size());
+    ArchivoColumna cab = {{'I', 'N', 'V', 'C', 'O', 'L', '1', 0}, tipo, FILAS_POR_BLOQUE, 0};
+    return fwrite(&cab, sizeof(cab), 1, f) == 1;
+  }
+
+  template <typename T>
+  bool escribir(const std::vector<T> &v) {
+    filas += v.size();
+    return v.empty() || fwrite(v.data(), sizeof(T), v.size(), f) == v.size();
+  }
+
+  template <typename T>
+  bool escribir(const T &v) {
+    filas++;
+    return fwrite(&v, sizeof(T), 1, f) == 1;
+  }
+
+  bool cerrar() {
+    bool ok = fseek(f, offsetof(ArchivoColumna, filas), SEEK_SET) == 0 &&
+              fwrite(&filas, sizeof(filas), 1, f) == 1;
+    return fclose(f) == 0 && ok;
+  }
+};
+
+/**
+ * @brief Escribe las columnas de todos los archivos y el índice de bloques.
+ */
+struct Escritor {
+  SalidaColumna ts, nodo, rssi, temp, hum, luz, co2, suelo, bloques;
+  Bloque bloqueActual = {0, 0, 0};
+  uint64_t filas = 0;
+  int64_t ultimoTs = INT64_MIN;
+  uint64_t desordenadas = 0;   // Filas con tiempo menor que la anterior entre días
+
+  bool abrir(const fs::path &dir) {
+    return ts.abrir(dir / "timestamp.col", TIPO_INT64) && nodo.abrir(dir / "nodeId.col", TIPO_UINT16) &&
+           rssi.abrir(dir / "rssi.col", TIPO_INT16) && temp.abrir(dir / "temp.col", TIPO_FLOAT32) &&
+           hum.abrir(dir / "hum.col", TIPO_FLOAT32) && luz.abrir(dir / "light.col", TIPO_UINT16) &&
+           co2.abrir(dir / "co2ppm.col", TIPO_FLOAT32) && suelo.abrir(dir / "soilMoisture.col", TIPO_FLOAT32) &&
+           bloques.abrir(dir / "bloques.idx", TIPO_BLOQUE);
+  }
+
+  bool escribir(const Columnas &c) {
+    for (size_t i = 0; i < c.filas(); i++) {
+      if (filas % FILAS_POR_BLOQUE == 0) {
+        if (filas > 0 && !bloques.escribir(bloqueActual)) {
+          return false;
+        }
+        bloqueActual = {filas, c.ts[i], c.ts[i]};
+      }
+      bloqueActual.tsMin = std::min(bloqueActual.tsMin, c.ts[i]);
+      bloqueActual.tsMax = std::max(bloqueActual.tsMax, c.ts[i]);
+      if (c.ts[i] < ultimoTs) {
+        desordenadas++;
+      }
+      ultimoTs = c.ts[i];
+      filas++;
+    }
+    return ts.escribir(c.ts) && nodo.escribir(c.nodo) && rssi.escribir(c.rssi) &&
+           temp.escribir(c.temp) && hum.escribir(c.hum) && luz.escribir(c.luz) &&
+           co2.escribir(c.co2) && suelo.escribir(c.suelo);
+  }
+
+  bool cerrar() {
+    bool ok = filas == 0 || bloques.escribir(bloqueActual);
+    ok = ts.cerrar() && ok;
+    ok = nodo.cerrar() && ok;
+    ok = rssi.cerrar() && ok;
+    ok = temp.cerrar() && ok;
+    ok = hum.cerrar() && ok;
+    ok = luz.cerrar() && ok;
+    ok = co2.cerrar() && ok;
+    ok = suelo.cerrar() && ok;
+    return bloques.cerrar() && ok;
+  }
+};
+
+//----------EJECUCION PARALELA---------------------------------
+/**
+ * @brief Resultado de una pasada de importación.
+ */
+struct Resultado {
+  uint64_t filas = 0;
+  uint64_t invalidas = 0;
+  uint64_t fallidos = 0;
+  uint64_t duplicadas = 0;
+  double segundos = 0;
+};
+
+/**
+ * @brief Parsea todos los días con n hilos y entrega cada uno en orden.
+ * @param escritor Destino, o NULL para medir solo el parseo.
+ *
+ * Cada hilo toma el siguiente día libre. El hilo principal escribe los
+ * resultados en el orden de la lista en cuanto están listos, así que la
+ * memoria solo guarda los días terminados fuera de orden.
+ */
+Resultado importar(const std::vector<Dia> &dias, unsigned n, Escritor *escritor) {
+  Resultado res;
+  std::vector<Columnas> columnas(dias.size());
+  std::vector<char> listo(dias.size(), 0);
+  std::atomic<size_t> siguiente(0);
+  std::atomic<uint64_t> invalidas(0), fallidos(0), duplicadas(0);
+  std::mutex m;
+  std::condition_variable cv;
+
+  auto t0 = std::chrono::steady_clock::now();
+  std::vector<std::thread> hilos;
+  for (unsigned h = 0; h < n; h++) {
+    hilos.emplace_back([&]() {
+      for (size_t i = siguiente++; i < dias.size(); i = siguiente++) {
+        uint64_t inv = 0, fal = 0, dup = 0;
+        parsearDia(dias[i], columnas[i], inv, fal, dup);
+        invalidas += inv;
+        fallidos += fal;
+        duplicadas += dup;
+        {
+          std::lock_guard<std::mutex> lock(m);
+          listo[i] = 1;
+        }
+        cv.notify_one();
+      }
+    });
+  }
+
+  for (size_t i = 0; i < dias.size(); i++) {
+    {
+      std::unique_lock<std::mutex> lock(m);
+      cv.wait(lock, [&]() { return listo[i] != 0; });
+    }
+    res.filas += columnas[i].filas();
+    if (escritor && !escritor->escribir(columnas[i])) {
+      fprintf(stderr, "Error escribiendo la salida\n");
+      fallidos++;
+    }
+    columnas[i].liberar();
+  }
+  for (auto &h : hilos) {
+    h.join();
+  }
+
+  res.segundos = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  res.invalidas = invalidas;
+  res.fallidos = fallidos;
+  res.duplicadas = duplicadas;
+  return res;
+}
+
+void imprimirResultado(const char *etiqueta, unsigned hilos, const Resultado &r, double base) {
+  printf("%-10s hilos=%-3u filas=%llu tiempo=%.3f s filas/s=%.0f aceleracion=%.2fx\n",
+         etiqueta, hilos, (unsigned long long) r.filas, r.segundos,
+         r.segundos > 0 ? r.filas / r.segundos : 0.0, r.segundos > 0 ? base / r.segundos : 0.0);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Uso: %s <raiz_sd> <dir_salida> [-j hilos] [--escalado]\n", argv[0]);
+    return 2;
+  }
+  unsigned hilos = std::max(1u, std::thread::hardware_concurrency());
+  bool escalado = false;
+  for (int i = 3; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      hilos = std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--escalado") == 0) {
+      escalado = true;
+    } else {
+      fprintf(stderr, "Opción desconocida: %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  std::vector<Dia> dias = buscarDias(argv[1]);
+  size_t archivos = 0;
+  for (const Dia &d : dias) {
+    archivos += d.horas.size() + !d.compactado.empty();
+  }
+  printf("%zu archivos de %zu días encontrados en %s\n", archivos, dias.size(), argv[1]);
+
+  // Escalado: solo parseo, de 1 a N hilos duplicando
+  if (escalado) {
+    double base = 0;
+    for (unsigned h = 1;; h = std::min(h * 2, hilos)) {
+      nodos.clear();
+      Resultado r = importar(dias, h, NULL);
+      if (h == 1) {
+        base = r.segundos;
+      }
+      imprimirResultado("parseo", h, r, base);
+      if (h == hilos) {
+        break;
+      }
+    }
+  }
+
+  std::error_code ec;
+  fs::create_directories(argv[2], ec);
+  Escritor escritor;
+  if (!escritor.abrir(argv[2])) {
+    fprintf(stderr, "No se pudo crear la salida en %s\n", argv[2]);
+    return 1;
+  }
+  nodos.clear();
+  Resultado r = importar(dias, hilos, &escritor);
+  bool ok = escritor.cerrar();
+
+  FILE *dict = fopen((fs::path(argv[2]) / "nodeId.dict").c_str(), "w");
+  if (dict) {
+    for (const auto &nombre : nodos) {
+      fprintf(dict, "%s\n", nombre.c_str());
+    }
+    ok = fclose(dict) == 0 && ok;
+  } else {
+    ok = false;
+  }
+
+  imprimirResultado("importacion", hilos, r, r.segundos);
+  printf("lineas invalidas=%llu archivos fallidos=%llu filas repetidas=%llu filas fuera de orden entre dias=%llu\n",
+         (unsigned long long) r.invalidas, (unsigned long long) r.fallidos,
+         (unsigned long long) r.duplicadas, (unsigned long long) escritor.desordenadas);
+  return ok && r.fallidos == 0 ? 0 : 1;
+}
@@ -0,0 +1,249 @@
+/**
+ * @file muestreo.h
+ * @brief Trama del nodo de sensores, conversión del MQ-135 y planificador de envíos.
+ *
+ * Sin acceso a hardware, para que las pruebas del PC puedan reproducir trazas
+ * con el mismo código que corre en el nodo.
+ */
+#ifndef NUCLEO_MUESTREO_H
+#define NUCLEO_MUESTREO_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "../prueba_3_corete/config_blob.h"
+
+// Constantes para sensor de CO2 (MQ-135)
+const float RL = 10000.0;     ///< Resistencia de carga en ohmios
+const float R0 = 10000.0;     ///< Resistencia base (calibrada)
+
+/**
+ * @struct struct_message
+ * @brief Estructura de datos enviada vía ESP-NOW.
+ */
+typedef struct struct_message {
+  float temp;        ///< Temperatura
+  float hum;         ///< Humedad
+  uint16_t lum;      ///< Luminosidad
+  float vCO2;        ///< CO2 estimado
+  float humSuelo;    ///< Humedad del suelo
+  uint8_t validez;   ///< Bits VALIDO_*: qué campos traen una lectura reciente
+} struct_message;
+
+// Bits de validez de cada campo de struct_message
+#define VALIDO_TEMP  (1 << 0)
+#define VALIDO_HUM   (1 << 1)
+#define VALIDO_LUM   (1 << 2)
+#define VALIDO_CO2   (1 << 3)
+#define VALIDO_SUELO (1 << 4)
+
+/**
+ * @brief Convierte una lectura ADC del MQ-135 en ppm de CO2 estimadas.
+ * @param adc Valor ADC de 12 bits.
+ * @return Concentración estimada en ppm.
+ */
+inline float calcularCO2(int adc) {
+  float voltage = adc * (3.3 / 4095.0);
+  float Rs = RL * (3.3 - voltage) / voltage;
+  float ratio = Rs / R0;
+  return pow(10, (-2.769 * log10(ratio) + 2.691));
+}
+
+//----------MUESTREO ADAPTATIVO---------------------------------
+// El planificador se evalúa cada periodoMuestreo con las últimas lecturas;
+// lo que se adapta es el envío por radio, que es lo que más consume.
+#define NUM_VARIABLES 5   // temp, hum, lum, CO2, humedad del suelo
+
+static const uint32_t periodoMuestreo = 1000;  // ms entre evaluaciones del planificador
+static const uint32_t tiempoCalma = 30000;     // ms sin cambios rápidos para pasar a modo lento
+static const uint32_t latidoLento = 60000;     // ms máximos sin enviar en modo lento
+
+/// Peso de cada muestra en el nivel y la pendiente suavizados (media móvil exponencial).
+static const float suavizado = 0.2;
+/// Pendiente suavizada (unidades/s) a partir de la cual una variable cambia rápido.
+/// Unas dos veces el máximo que da el ruido de cada sensor en reposo (DHT11
+/// 0.1 °C y 1 %, ADC unas 20 cuentas); calibradas con pruebas/trazas.
+static const float pendienteRapida[NUM_VARIABLES] = {0.2, 1.0, 35, 40, 1.0};
+/// Diferencia del nivel suavizado con el del último envío que fuerza un envío
+/// aunque la variable sea lenta.
+static const float bandaMuerta[NUM_VARIABLES] = {0.5, 2, 100, 50, 2};
+
+// Alarma de fuego: el LDR se vigila cada periodoAlarma (trabajoAlarma) y un
+// cruce de lumAlarma se reenvía hasta que la radio confirma la entrega. El
+// nodo central apaga ESP-NOW en sus ventanas WiFi y, si su punto de acceso
+// está en este canal, la radio puede confirmar una trama que nadie procesa:
+// por eso la alarma activa se repite además cada latidoAlarma.
+#define UMBRAL_ALARMA (1 << 3)   ///< Bit de estadoUmbrales del cruce de lumAlarma
+
+static const uint32_t periodoAlarma = 100;    // ms entre comprobaciones rápidas del LDR
+static const uint32_t latidoAlarma = 5000;    // ms máximos sin enviar con la alarma activa
+/// Cuentas ADC bajo lumAlarma para dar la alarma por terminada (igual que en el nodo central).
+static const uint16_t histeresisAlarma = 100;
+
+/**
+ * @brief Estado del planificador de envíos.
+ */
+typedef struct Planificador {
+  float anterior[NUM_VARIABLES];   ///< Muestra anterior
+  float nivel[NUM_VARIABLES];      ///< Valor suavizado
+  float enviado[NUM_VARIABLES];    ///< Nivel suavizado en el último envío
+  float pendiente[NUM_VARIABLES];  ///< Pendiente suavizada (unidades/s)
+  uint16_t estadoEnviado;          ///< Umbrales cruzados y validez en el último envío
+  uint16_t estadoConfirmado;       ///< Último estado cuya entrega confirmó la radio
+  bool enVuelo;                    ///< Envío sin resultado de la radio todavía
+  uint32_t tMuestra;               ///< ms de la muestra anterior
+  uint32_t tEnvio;                 ///< ms del último envío
+  uint32_t tCambioRapido;          ///< ms del último cambio rápido
+  bool iniciado;
+  // Estadísticas
+  uint32_t muestras;
+  uint32_t enviosUmbral;
+  uint32_t enviosRapidos;
+  uint32_t enviosBanda;
+  uint32_t enviosLatido;
+  uint32_t enviosReintento;
+  uint32_t enviosFallidos;
+} Planificador;
+
+/**
+ * @brief Indica si una luminosidad está por encima del umbral de alarma.
+ * @param activa La alarma estaba activa: se mantiene hasta bajar de lumAlarma - histeresisAlarma.
+ */
+inline bool luzCritica(const ConfigBlob *cfg, float lum, bool activa) {
+  return activa ? lum > cfg->lumAlarma - histeresisAlarma : lum > cfg->lumAlarma;
+}
+
+/**
+ * @brief Máscara de umbrales cruzados según la configuración activa.
+ *
+ * Un bit por cada condición que el nodo central usa para decidir actuadores,
+ * así cualquier cruce se detecta como un cambio de la máscara.
+ * @param anterior Máscara anterior, para la histéresis de UMBRAL_ALARMA.
+ */
+inline uint8_t estadoUmbrales(const ConfigBlob *cfg, const float v[], uint8_t anterior = 0) {
+  uint8_t e = 0;
+  if (v[0] > cfg->tempMax) e |= 1 << 0;
+  if (v[0] < cfg->tempMin) e |= 1 << 1;
+  if (v[1] > cfg->humMax) e |= 1 << 2;
+  if (luzCritica(cfg, v[2], anterior & UMBRAL_ALARMA)) e |= UMBRAL_ALARMA;
+  if (v[2] < cfg->lumLed) e |= 1 << 4;
+  if (v[3] >= cfg->co2Max) e |= 1 << 5;
+  if (v[4] < cfg->humSueloMin) e |= 1 << 6;
+  return e;
+}
+
+/**
+ * @brief Registra una muestra y decide si debe enviarse.
+ * @param p Estado del planificador.
+ * @param v Valores de la muestra (NUM_VARIABLES).
+ * @param estado Máscara de umbrales de la muestra, con la validez en los bits altos.
+ * @param ahora Tiempo actual en ms.
+ * @return true si hay que transmitir esta muestra.
+ *
+ * Se envía de inmediato si cambia algún cruce de umbral o la validez de
+ * algún campo, y se reenvía en cada muestra hasta que la radio confirme ese
+ * estado (planificadorConfirmar); cada latidoAlarma con la alarma activa; en
+ * cada muestra mientras la pendiente suavizada de alguna variable supere pendienteRapida
+ * (y hasta tiempoCalma después); si el nivel suavizado de una variable se
+ * aleja más de su banda muerta del último envío; y como latido cada
+ * latidoLento. Nivel y pendiente se suavizan porque la diferencia entre dos
+ * muestras seguidas es sobre todo ruido.
+ */
+inline bool planificadorMuestra(Planificador *p, const float v[], uint16_t estado, uint32_t ahora) {
+  p->muestras++;
+  if (!p->iniciado) {
+    p->iniciado = true;
+    p->tCambioRapido = ahora;
+    memcpy(p->nivel, v, sizeof(p->nivel));
+    p->enviosUmbral++;
+  } else {
+    float dt = (ahora - p->tMuestra) / 1000.0;
+    bool lejos = false;
+    for (int i = 0; i < NUM_VARIABLES; i++) {
+      if (dt > 0) {
+        p->pendiente[i] += suavizado * ((v[i] - p->anterior[i]) / dt - p->pendiente[i]);
+      }
+      p->nivel[i] += suavizado * (v[i] - p->nivel[i]);
+      if (fabs(p->pendiente[i]) > pendienteRapida[i]) {
+        p->tCambioRapido = ahora;
+      }
+      if (fabs(p->nivel[i] - p->enviado[i]) > bandaMuerta[i]) {
+        lejos = true;
+      }
+    }
+
+    if (estado != p->estadoEnviado) {
+      p->enviosUmbral++;
+    } else if (estado != p->estadoConfirmado ||
+               ((estado & UMBRAL_ALARMA) && ahora - p->tEnvio >= latidoAlarma)) {
+      p->enviosReintento++;
+    } else if (ahora - p->tCambioRapido < tiempoCalma) {
+      p->enviosRapidos++;
+    } else if (lejos) {
+      p->enviosBanda++;
+    } else if (ahora - p->tEnvio >= latidoLento) {
+      p->enviosLatido++;
+    } else {
+      memcpy(p->anterior, v, sizeof(p->anterior));
+      p->tMuestra = ahora;
+      return false;
+    }
+  }
+
+  memcpy(p->anterior, v, sizeof(p->anterior));
+  memcpy(p->enviado, p->nivel, sizeof(p->enviado));
+  p->estadoEnviado = estado;
+  p->enVuelo = true;
+  p->tMuestra = ahora;
+  p->tEnvio = ahora;
+  return true;
+}
+
+/**
+ * @brief Registra un envío de trabajoAlarma, fuera del periodo de muestreo.
+ * @param estado Máscara de umbrales de la trama enviada, con la validez en los bits altos.
+ *
+ * No es una muestra: nivel, pendiente y muestra anterior siguen como los dejó
+ * planificadorMuestra, que supone muestras cada periodoMuestreo. Solo cambian
+ * el estado enviado (para confirmarlo y reenviarlo) y el momento del envío.
+ */
+inline void planificadorEnvioAlarma(Planificador *p, uint16_t estado, uint32_t ahora) {
+  if (estado != p->estadoEnviado) {
+    p->enviosUmbral++;
+  } else {
+    p->enviosReintento++;
+  }
+  p->estadoEnviado = estado;
+  p->enVuelo = true;
+  p->tEnvio = ahora;
+}
+
+/**
+ * @brief Registra el resultado de la radio para el último envío.
+ * @param entregado ESP_NOW_SEND_SUCCESS en OnDataSent; false también si esp_now_send falló.
+ */
+inline void planificadorConfirmar(Planificador *p, bool entregado) {
+  p->enVuelo = false;
+  if (entregado) {
+    p->estadoConfirmado = p->estadoEnviado;
+  } else {
+    p->enviosFallidos++;
+  }
+}
+
+/**
+ * @brief Decide si trabajoAlarma debe enviar sin esperar al trabajo de envío.
+ *
+ * Hay que enviar si el LDR cruzó lumAlarma (con histéresis) respecto a lo
+ * último enviado, o si ese cruce sigue sin confirmar y no hay otro envío en
+ * curso.
+ */
+inline bool alarmaPorEnviar(const Planificador *p, const ConfigBlob *cfg, float lum) {
+  bool enviada = p->estadoEnviado & UMBRAL_ALARMA;
+  if (luzCritica(cfg, lum, enviada) != enviada) {
+    return true;
+  }
+  return !p->enVuelo && enviada != (bool) (p->estadoConfirmado & UMBRAL_ALARMA);
+}
+
+#endif
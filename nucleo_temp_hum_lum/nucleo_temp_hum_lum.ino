@@ -9,6 +9,11 @@
 #include <esp_now.h>
 #include <WiFi.h>
 #include <DHT.h>
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "../prueba_3_corete/config_blob.h"
+#include "muestreo.h"
 
 /// Pin digital al que está conectado el sensor DHT.
 #define DHTPIN 4
@@ -22,8 +27,131 @@
 /// Objeto para lectura del sensor DHT.
 DHT dht(DHTPIN, DHTTYPE);
 
-/// Dirección MAC del receptor ESP-NOW.
-uint8_t broadcastAddress[] = {0xC8, 0xF0, 0x9E, 0x7B, 0x78, 0x88};
+// Configuración recargable (la MAC del receptor es cfgActiva->macNucleoC)
+// Formato, CRC y valores por defecto en prueba_3_corete/config_blob.h
+
+/// Configuración en uso. Cada decisión copia el puntero una sola vez al empezar.
+const ConfigBlob * volatile cfgActiva = &cfgPorDefecto;
+
+const esp_partition_t *cfgParticion = NULL;
+const uint8_t *cfgMapa = NULL;            // Las dos ranuras mapeadas en memoria
+esp_partition_mmap_handle_t cfgMapaHandle;
+ConfigBlob cfgPendiente;                  // Recibida por ESP-NOW, aún sin escribir
+volatile bool cfgHayPendiente = false;
+int64_t cfgUltimaConmutacion = 0;
+
+// Mediciones (microsegundos)
+int64_t cfgTiempoArranque = 0;
+int64_t cfgTiempoEscritura = 0;
+int64_t cfgTiempoConmutacion = 0;
+
+/**
+ * @brief Devuelve la ranura i de la partición mapeada.
+ */
+const ConfigBlob *cfgRanura(int i) {
+  return (const ConfigBlob *) (cfgMapa + i * CFG_TAM_RANURA);
+}
+
+/**
+ * @brief Mapea la partición de configuración y activa la ranura válida más reciente.
+ */
+void cfgIniciar() {
+  int64_t t0 = esp_timer_get_time();
+  cfgParticion = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "invcfg");
+  if (cfgParticion == NULL || cfgParticion->size < 2 * CFG_TAM_RANURA ||
+      esp_partition_mmap(cfgParticion, 0, 2 * CFG_TAM_RANURA, ESP_PARTITION_MMAP_DATA,
+                         (const void **) &cfgMapa, &cfgMapaHandle) != ESP_OK) {
+    cfgMapa = NULL;
+    Serial.println("⚠️ Sin partición de configuración, se usan los valores de compilación");
+  } else {
+    for (int i = 0; i < 2; i++) {
+      const ConfigBlob *c = cfgRanura(i);
+      if (cfgEsValida(c) && c->generacion > cfgActiva->generacion) {
+        cfgActiva = c;
+      }
+    }
+  }
+  cfgTiempoArranque = esp_timer_get_time() - t0;
+  Serial.printf("Configuración generación %u cargada en %lld us\n",
+                (unsigned) cfgActiva->generacion, cfgTiempoArranque);
+}
+
+/**
+ * @brief Acepta una configuración recibida por ESP-NOW si es válida, más nueva
+ * y enviada por el nodo central.
+ * @param origen MAC del remitente.
+ * @return true si el mensaje era una configuración (válida o no).
+ *
+ * Se llama desde el callback de recepción, por eso solo copia a RAM; la
+ * escritura en flash la hace cfgAplicarPendiente() desde loop().
+ */
+bool cfgRecibir(const uint8_t *origen, const uint8_t *incomingData, int len) {
+  ConfigBlob nueva;
+  switch (cfgEvaluar(incomingData, len, origen, cfgActiva, &nueva)) {
+    case CFG_NO_ES_CONFIG:
+      return false;
+    case CFG_ORIGEN_DESCONOCIDO:
+      Serial.println("Configuración descartada: no viene del nodo central");
+      break;
+    case CFG_INVALIDA:
+      Serial.println("Configuración descartada: CRC, firma o versión incorrectos");
+      break;
+    case CFG_ANTIGUA:
+      Serial.println("Configuración descartada: generación antigua");
+      break;
+    case CFG_ACEPTADA:
+      if (!cfgHayPendiente) {
+        cfgPendiente = nueva;
+        cfgHayPendiente = true;
+      }
+      break;
+  }
+  return true;
+}
+
+/**
+ * @brief Escribe la configuración pendiente en la ranura inactiva y conmuta.
+ *
+ * La ranura que se borra es la que estaba activa antes de la última
+ * conmutación; CFG_INTERVALO_MIN_MS garantiza que ningún lector la siga usando.
+ */
+void cfgAplicarPendiente() {
+  if (!cfgHayPendiente) {
+    return;
+  }
+  if (cfgMapa == NULL) {
+    Serial.println("❌ No hay partición donde guardar la configuración");
+    cfgHayPendiente = false;
+    return;
+  }
+  if (esp_timer_get_time() - cfgUltimaConmutacion < CFG_INTERVALO_MIN_MS * 1000LL) {
+    return;
+  }
+
+  int destino = (cfgActiva == cfgRanura(0)) ? 1 : 0;
+  size_t offset = destino * CFG_TAM_RANURA;
+  int64_t t0 = esp_timer_get_time();
+  if (esp_partition_erase_range(cfgParticion, offset, CFG_TAM_RANURA) != ESP_OK ||
+      esp_partition_write(cfgParticion, offset, &cfgPendiente, sizeof(ConfigBlob)) != ESP_OK ||
+      !cfgEsValida(cfgRanura(destino))) {
+    Serial.println("❌ Falló la escritura de la configuración");
+    cfgHayPendiente = false;
+    return;
+  }
+  int64_t t1 = esp_timer_get_time();
+  cfgActiva = cfgRanura(destino);
+  int64_t t2 = esp_timer_get_time();
+
+  cfgTiempoEscritura = t1 - t0;
+  cfgTiempoConmutacion = t2 - t1;
+  cfgUltimaConmutacion = t2;
+  cfgHayPendiente = false;
+  Serial.printf("Configuración generación %u activa (escritura %lld us, conmutación %lld us)\n",
+                (unsigned) cfgActiva->generacion, cfgTiempoEscritura, cfgTiempoConmutacion);
+}
+
+/// MAC con la que está registrado el peer receptor.
+uint8_t peerReceptor[6];
 
 // Variables para almacenamiento de lecturas de sensores
 float temperature;         ///< Temperatura en grados Celsius
@@ -35,34 +163,19 @@ float valHumsuelo;         ///< Humedad del suelo en porcentaje
 // Variables y constantes para sensor de CO2 (MQ-135)
 const int sensorPin = 35;     ///< Pin del sensor MQ
 const int humsuelo = 33;      ///< Pin del sensor de humedad del suelo
-const float RL = 10000.0;     ///< Resistencia de carga en ohmios
-const float R0 = 10000.0;     ///< Resistencia base (calibrada)
 int adcValue = 0;
-float voltage = 0;
-float Rs = 0;
-float ratio = 0;
 
 /// Resultado del envío (éxito o fallo).
 String success;
 
-/**
- * @struct struct_message
- * @brief Estructura de datos enviada vía ESP-NOW.
- */
-typedef struct struct_message {
-  float temp;        ///< Temperatura
-  float hum;         ///< Humedad
-  uint16_t lum;      ///< Luminosidad
-  float vCO2;        ///< CO2 estimado
-  float humSuelo;    ///< Humedad del suelo
-} struct_message;
-
-/// Instancia de la estructura de datos a enviar.
 struct_message readingsToSend;
 
 /// Información del peer ESP-NOW.
 esp_now_peer_info_t peerInfo;
 
+/// Resultado del último envío según OnDataSent: 1 entregado, 0 fallido, -1 ya procesado.
+volatile int8_t envioResultado = -1;
+
 /**
  * @brief Callback al enviar datos por ESP-NOW.
  * 
@@ -70,71 +183,174 @@ esp_now_peer_info_t peerInfo;
  * @param status Estado del envío (éxito o fallo).
  */
 void OnDataSent(const uint8_t *mac_addr, esp_now_send_status_t status) {
+  envioResultado = status == ESP_NOW_SEND_SUCCESS ? 1 : 0;
   Serial.print("\r\nEstado del envío:\t");
   Serial.println(status == ESP_NOW_SEND_SUCCESS ? "Éxito" : "Fallo");
   success = (status == ESP_NOW_SEND_SUCCESS) ? "Éxito :)" : "Fallo :(";
 }
 
+//----------MUESTREO ADAPTATIVO---------------------------------
+// Planificador de envíos en muestreo.h
+
+Planificador planificador;
+
 /**
- * @brief Función de configuración. Inicializa sensores, ESP-NOW y el peer receptor.
+ * @brief Pasa al planificador el resultado que dejó OnDataSent, si hay uno.
  */
-void setup() {
-  Serial.begin(115200);
-  dht.begin();
-  pinMode(LDR_PIN, INPUT);
-  pinMode(humsuelo, INPUT);
-  WiFi.mode(WIFI_STA);
-
-  if (esp_now_init() != ESP_OK) {
-    Serial.println("Error inicializando ESP-NOW");
-    return;
+void procesarResultadoEnvio() {
+  int8_t r = envioResultado;
+  if (r >= 0) {
+    envioResultado = -1;
+    planificadorConfirmar(&planificador, r == 1);
   }
+}
 
-  esp_now_register_send_cb(OnDataSent);
+// Core de las tareas de la aplicación; el 0 es el de la pila de WiFi
+#if CONFIG_FREERTOS_UNICORE
+static const BaseType_t app_cpu = 0;
+#else
+static const BaseType_t app_cpu = 1;
+#endif
 
-  memcpy(peerInfo.peer_addr, broadcastAddress, 6);
-  peerInfo.channel = 0;
-  peerInfo.encrypt = false;
+//----------ADQUISICION-----------------------------------------
+// El DHT11 se lee en su propia tarea (su lectura es una transacción lenta por
+// software); los canales ADC y el envío son trabajos con periodo propio en
+// loop(). Un sensor lento o fallido solo pierde su bit de validez.
+static const uint32_t periodoDHT = 2000;  // ms, el DHT11 no da datos nuevos más rápido
+static const uint32_t maxEdadDHT = 5000;  // ms tras los que una lectura DHT deja de ser válida
+static const uint32_t periodoADC = 1000;  // ms entre lecturas de LDR, MQ-135 y suelo
+// periodoAlarma (comprobaciones rápidas del LDR) en muestreo.h
 
-  if (esp_now_add_peer(&peerInfo) != ESP_OK) {
-    Serial.println("Fallo al agregar peer");
-    return;
+/**
+ * @brief Latencia de adquisición de un sensor.
+ */
+typedef struct Latencia {
+  uint32_t ultimaUs;
+  uint32_t maxUs;
+  uint32_t lecturas;
+  uint32_t fallos;
+} Latencia;
+
+Latencia latDHT, latLDR, latCO2, latSuelo;
+
+// Última lectura válida del DHT, escrita por tareaDHT
+portMUX_TYPE dhtMux = portMUX_INITIALIZER_UNLOCKED;
+float dhtTemp = 0;
+float dhtHum = 0;
+uint32_t dhtMarca = 0;       // millis() de la última lectura válida
+bool dhtAlgunaVez = false;
+
+uint8_t validezADC = 0;      // VALIDO_* de los canales ADC
+
+/**
+ * @brief Acumula una medición de latencia.
+ * @param t0 micros() al empezar la lectura.
+ * @param ok La lectura fue válida.
+ */
+void registrarLatencia(Latencia *l, uint32_t t0, bool ok) {
+  uint32_t d = micros() - t0;
+  l->ultimaUs = d;
+  if (d > l->maxUs) {
+    l->maxUs = d;
+  }
+  l->lecturas++;
+  if (!ok) {
+    l->fallos++;
   }
 }
 
 /**
- * @brief Función principal de bucle. Lee sensores, calcula valores, envía por ESP-NOW y muestra resultados por consola.
+ * @brief Tarea que lee el DHT11 cada periodoDHT sin bloquear al resto.
  */
-void loop() {
-  // Leer sensores
-  temperature = dht.readTemperature();
-  humidity = dht.readHumidity();
+void tareaDHT(void *parameter) {
+  while (true) {
+    uint32_t t0 = micros();
+    float t = dht.readTemperature();
+    float h = dht.readHumidity();
+    bool ok = !isnan(t) && !isnan(h);
+    registrarLatencia(&latDHT, t0, ok);
+    if (ok) {
+      portENTER_CRITICAL(&dhtMux);
+      dhtTemp = t;
+      dhtHum = h;
+      dhtMarca = millis();
+      dhtAlgunaVez = true;
+      portEXIT_CRITICAL(&dhtMux);
+    } else {
+      Serial.println("Error al leer el sensor DHT");
+    }
+    vTaskDelay(periodoDHT / portTICK_PERIOD_MS);
+  }
+}
+
+/**
+ * @brief Trabajo ADC: lee LDR, MQ-135 y humedad del suelo.
+ *
+ * El MQ-135 se marca inválido si el ADC está en 0 o saturado, porque ahí la
+ * conversión a ppm no tiene sentido.
+ */
+void trabajoADC() {
+  uint32_t t0 = micros();
   luminosity = analogRead(LDR_PIN);
-  valHumsuelo = map(analogRead(humsuelo), 4092, 0, 0, 100);
+  registrarLatencia(&latLDR, t0, true);
+
+  t0 = micros();
   adcValue = analogRead(sensorPin);
-  voltage = adcValue * (3.3 / 4095.0);
-  Rs = RL * (3.3 - voltage) / voltage;
-  ratio = Rs / R0;
-  CO2 = pow(10, (-2.769 * log10(ratio) + 2.691));
-
-  // Validación de lecturas
-  if (isnan(temperature) || isnan(humidity)) {
-    Serial.println("Error al leer el sensor DHT");
-    return;
+  bool co2Ok = adcValue > 0 && adcValue < 4095;
+  if (co2Ok) {
+    CO2 = calcularCO2(adcValue);
   }
+  registrarLatencia(&latCO2, t0, co2Ok);
+
+  t0 = micros();
+  valHumsuelo = map(analogRead(humsuelo), 4092, 0, 0, 100);
+  registrarLatencia(&latSuelo, t0, true);
+
+  validezADC = VALIDO_LUM | VALIDO_SUELO | (co2Ok ? VALIDO_CO2 : 0);
+}
 
+/**
+ * @brief Copia las últimas lecturas en valores (NUM_VARIABLES) y devuelve sus bits de validez.
+ *
+ * Los campos inválidos conservan su último valor.
+ */
+uint8_t tomarLecturas(float valores[]) {
+  uint8_t validez = validezADC;
+  portENTER_CRITICAL(&dhtMux);
+  if (dhtAlgunaVez && millis() - dhtMarca < maxEdadDHT) {
+    validez |= VALIDO_TEMP | VALIDO_HUM;
+  }
+  temperature = dhtTemp;
+  humidity = dhtHum;
+  portEXIT_CRITICAL(&dhtMux);
+
+  valores[0] = temperature;
+  valores[1] = humidity;
+  valores[2] = luminosity;
+  valores[3] = CO2;
+  valores[4] = valHumsuelo;
+  return validez;
+}
+
+/**
+ * @brief Arma la trama con las últimas lecturas y la transmite.
+ */
+void enviarLecturas(uint8_t validez) {
   // Asignación de datos
   readingsToSend.temp = temperature;
   readingsToSend.hum = humidity;
   readingsToSend.lum = luminosity;
   readingsToSend.vCO2 = CO2;
   readingsToSend.humSuelo = valHumsuelo;
+  readingsToSend.validez = validez;
 
   // Enviar datos
-  esp_err_t result = esp_now_send(broadcastAddress, (uint8_t *) &readingsToSend, sizeof(readingsToSend));
+  esp_err_t result = esp_now_send(peerReceptor, (uint8_t *) &readingsToSend, sizeof(readingsToSend));
   if (result == ESP_OK) {
     Serial.println("Datos enviados exitosamente");
   } else {
+    // No habrá OnDataSent: el estado queda sin confirmar y se reenvía
+    planificadorConfirmar(&planificador, false);
     Serial.println("Error al enviar los datos");
   }
 
@@ -142,11 +358,11 @@ void loop() {
   Serial.println("LECTURAS ENVIADAS:");
   Serial.print("Temperatura: ");
   Serial.print(temperature);
-  Serial.println(" ºC");
+  Serial.println(validez & VALIDO_TEMP ? " ºC" : " ºC (sin lectura reciente)");
 
   Serial.print("Humedad: ");
   Serial.print(humidity);
-  Serial.println(" %");
+  Serial.println(validez & VALIDO_HUM ? " %" : " % (sin lectura reciente)");
 
   Serial.print("Luminosidad: ");
   Serial.print(luminosity);
@@ -154,11 +370,160 @@ void loop() {
 
   Serial.print("PPM CO2 estimado: ");
   Serial.print(CO2);
-  Serial.println("ppm");
+  Serial.println(validez & VALIDO_CO2 ? "ppm" : "ppm (lectura fuera de rango)");
 
   Serial.print("Humedad del suelo: ");
   Serial.print(valHumsuelo);
   Serial.println(" %");
 
-  delay(1000); // Espera 1 segundo
+  Serial.printf("Muestras: %u, envíos por umbral/rápidos/banda/latido/reintento: %u/%u/%u/%u/%u, fallidos %u\n",
+                (unsigned) planificador.muestras, (unsigned) planificador.enviosUmbral,
+                (unsigned) planificador.enviosRapidos, (unsigned) planificador.enviosBanda,
+                (unsigned) planificador.enviosLatido, (unsigned) planificador.enviosReintento,
+                (unsigned) planificador.enviosFallidos);
+  Serial.printf("Latencia us (última/máx, fallos): DHT %u/%u %u, LDR %u/%u, CO2 %u/%u %u, suelo %u/%u\n",
+                (unsigned) latDHT.ultimaUs, (unsigned) latDHT.maxUs, (unsigned) latDHT.fallos,
+                (unsigned) latLDR.ultimaUs, (unsigned) latLDR.maxUs,
+                (unsigned) latCO2.ultimaUs, (unsigned) latCO2.maxUs, (unsigned) latCO2.fallos,
+                (unsigned) latSuelo.ultimaUs, (unsigned) latSuelo.maxUs);
+}
+
+/**
+ * @brief Trabajo de envío: pasa las últimas lecturas al planificador y las
+ * transmite si este lo decide.
+ */
+void trabajoEnvio() {
+  float valores[NUM_VARIABLES];
+  uint8_t validez = tomarLecturas(valores);
+  uint16_t estado = estadoUmbrales(cfgActiva, valores, planificador.estadoEnviado) | (validez << 8);
+  if (planificadorMuestra(&planificador, valores, estado, millis())) {
+    enviarLecturas(validez);
+  }
+}
+
+/**
+ * @brief Trabajo de alarma: vigila el LDR más a menudo que el resto y, si cambia
+ * el cruce de lumAlarma respecto a lo último enviado o ese cruce sigue sin
+ * confirmar, envía sin esperar al siguiente trabajo de envío.
+ *
+ * No pasa la muestra por planificadorMuestra: su pendiente supone muestras
+ * cada periodoMuestreo.
+ */
+void trabajoAlarma() {
+  procesarResultadoEnvio();
+  int lum = analogRead(LDR_PIN);
+  if (!alarmaPorEnviar(&planificador, cfgActiva, lum)) {
+    return;
+  }
+  luminosity = lum;
+  float valores[NUM_VARIABLES];
+  uint8_t validez = tomarLecturas(valores);
+  uint16_t estado = estadoUmbrales(cfgActiva, valores, planificador.estadoEnviado) | (validez << 8);
+  planificadorEnvioAlarma(&planificador, estado, millis());
+  enviarLecturas(validez);
+}
+
+/**
+ * @brief Trabajo periódico ejecutado desde loop().
+ */
+typedef struct Trabajo {
+  const char *nombre;
+  uint32_t periodoMs;
+  void (*ejecutar)();
+  uint32_t proximo;   ///< millis() de la próxima ejecución
+} Trabajo;
+
+/// Se ejecutan en este orden cuando coinciden, así el envío usa el ADC recién leído.
+Trabajo trabajos[] = {
+  {"Alarma", periodoAlarma, trabajoAlarma, 0},
+  {"ADC", periodoADC, trabajoADC, 0},
+  {"Envio", periodoMuestreo, trabajoEnvio, 0},
+};
+
+/**
+ * @brief Callback al recibir datos por ESP-NOW (solo configuraciones nuevas).
+ */
+void OnDataRecv(const esp_now_recv_info_t *info, const uint8_t *incomingData, int len) {
+  cfgRecibir(info->src_addr, incomingData, len);
+}
+
+/**
+ * @brief Registra como peer el nodo central de la configuración activa.
+ * @return true si se pudo agregar.
+ */
+bool registrarReceptor() {
+  memcpy(peerInfo.peer_addr, cfgActiva->macNucleoC, 6);
+  peerInfo.channel = 0;
+  peerInfo.encrypt = false;
+
+  if (esp_now_add_peer(&peerInfo) != ESP_OK) {
+    Serial.println("Fallo al agregar peer");
+    return false;
+  }
+  memcpy(peerReceptor, peerInfo.peer_addr, 6);
+  return true;
+}
+
+/**
+ * @brief Función de configuración. Inicializa sensores, ESP-NOW y el peer receptor.
+ */
+void setup() {
+  Serial.begin(115200);
+  dht.begin();
+  pinMode(LDR_PIN, INPUT);
+  pinMode(humsuelo, INPUT);
+  cfgIniciar();
+  // En el core de la aplicación: la lectura del DHT desactiva las
+  // interrupciones unos ms y en el core 0 pararía la pila de WiFi/ESP-NOW
+  xTaskCreatePinnedToCore(tareaDHT, "DHT", 3072, NULL, 1, NULL, app_cpu);
+  WiFi.mode(WIFI_STA);
+
+  if (esp_now_init() != ESP_OK) {
+    Serial.println("Error inicializando ESP-NOW");
+    return;
+  }
+
+  esp_now_register_send_cb(OnDataSent);
+  esp_now_register_recv_cb(OnDataRecv);
+
+  if (!registrarReceptor()) {
+    return;
+  }
+}
+
+/**
+ * @brief Función principal de bucle. Ejecuta los trabajos que tocan (ADC y envío)
+ * y duerme hasta el siguiente; el DHT se lee en tareaDHT.
+ */
+void loop() {
+  procesarResultadoEnvio();
+  // Aplicar configuración recibida y cambiar de receptor si hace falta
+  cfgAplicarPendiente();
+  if (memcmp(peerReceptor, cfgActiva->macNucleoC, 6) != 0) {
+    esp_now_del_peer(peerReceptor);
+    registrarReceptor();
+  }
+
+  uint32_t espera = UINT32_MAX;
+  for (size_t i = 0; i < sizeof(trabajos) / sizeof(trabajos[0]); i++) {
+    Trabajo &t = trabajos[i];
+    uint32_t ahora = millis();
+    if ((int32_t) (ahora - t.proximo) >= 0) {
+      t.ejecutar();
+      t.proximo += t.periodoMs;
+      // Si el trabajo se atrasó más de un periodo, no se recuperan las ejecuciones perdidas
+      if ((int32_t) (millis() - t.proximo) >= 0) {
+        t.proximo = millis() + t.periodoMs;
+      }
+    }
+    uint32_t falta = t.proximo - millis();
+    if ((int32_t) falta > 0 && falta < espera) {
+      espera = falta;
+    } else if ((int32_t) falta <= 0) {
+      espera = 0;
+    }
+  }
+  if (espera > 0) {
+    delay(espera);
+  }
 }
@@ -0,0 +1,149 @@
+/**
+ * @file alarma_critica.h
+ * @brief Canal de alarma crítica del nodo central: detección, trama y cota de latencia.
+ *
+ * La alarma de fuego no espera al ciclo de taskESPNow: OnDataRecv llama a
+ * alarmaEvaluar con cada trama del sensor y, si el estado cambia, despierta a
+ * tareaAlarmaCritica (en el sketch), que envía una trama TIPO_COMANDO_CRITICO
+ * (formato de grupo, secuencia propia, solo SAL_ALARMA) reintentosAlarma
+ * veces. Mientras ESP-NOW está activo la repite cada refrescoAlarma para que
+ * los actuadores mantengan el enclavamiento. Si el sensor calla, la alarma se
+ * da por terminada cuando su luz deja de ser usable (maxEdadLectura,
+ * alarmaCaducar) en vez de repetir "fuego" indefinidamente.
+ *
+ * La ventana WiFi (switchToWiFi a switchToESPNow) apaga ESP-NOW y este nodo
+ * deja de oír al sensor, así que no se abre mientras alarmaCritica está
+ * activa ni con un cambio pendiente (ventanaWiFiPermitida): el aviso de
+ * Telegram de esa condición sale cuando la alarma termina. La ventana dura
+ * como mucho ventanaWiFiMax: la conexión al punto de acceso, la resolución
+ * DNS (en una tarea aparte que taskWiFi espera dnsTelegramMax), TCP, TLS y la
+ * respuesta de Telegram tienen cada una su límite.
+ *
+ * Latencia del cruce de lumAlarma en el LDR a la salida del actuador:
+ *  - cotaAlarma, con ESP-NOW activo: el sensor comprueba el LDR cada
+ *    periodoAlarmaSensor y reenvía el cruce hasta que la radio lo confirma;
+ *    OnDataRecv despierta a tareaAlarmaCritica, que envía reintentosAlarma
+ *    copias separadas separacionReintentos; margenAlarma cubre el aire, la
+ *    notificación y tareaSalidas del actuador;
+ *  - cotaAlarmaVentana, si el cruce llega con una ventana ya abierta (o
+ *    abriéndose): se suma la ventana entera. En otro canal el sensor reintenta
+ *    y sale al volver ESP-NOW (switchToESPNow registra OnDataRecv y despierta
+ *    a la tarea); en el mismo canal la radio puede confirmar una trama que
+ *    nadie procesa y la cubre la repetición cada latidoAlarmaSensor, que se
+ *    comprueba en cada muestra (periodoMuestreoSensor). Como la ventana no se
+ *    vuelve a abrir con la alarma activa, solo puede retrasarla una.
+ * La prueba pruebas/prueba_alarma.cpp recorre la cadena con estas funciones y
+ * una radio con retardo; en el nodo se miden alarmaLatenciaMaxUs y
+ * ventanaWiFiMaxUs.
+ */
+#ifndef CENTRAL_ALARMA_CRITICA_H
+#define CENTRAL_ALARMA_CRITICA_H
+
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "config_blob.h"
+#include "control.h"
+
+#define TIPO_COMANDO_CRITICO 0xA6
+
+static const int reintentosAlarma = 3;        // copias de cada cambio (broadcast sin ACK)
+static const int separacionReintentos = 10;   // ms entre copias
+static const int refrescoAlarma = 1000;       // ms entre repeticiones del estado
+/// Cuentas ADC bajo lumAlarma para dar la alarma por terminada (igual que en el sensor).
+static const int histeresisAlarma = 100;
+
+// Ventana WiFi: límites de cada paso mientras ESP-NOW está apagado
+static const int limpiar_hardware = 200;        // ms para que la radio se asiente al cambiar de modo
+static const int conexionWiFiMax = 4000;        // ms esperando al punto de acceso antes de desistir
+static const int dnsTelegramMax = 2000;         // ms esperando la resolución de api.telegram.org
+static const int tcpTelegramMax = 2000;         // ms de conexión TCP con Telegram
+static const int tlsTelegramMax = 3000;         // ms de handshake TLS (segundos enteros)
+static const int respuestaTelegramMax = 1500;   // ms esperando la respuesta de Telegram
+static const int ventanaWiFiMax = 2 * limpiar_hardware + conexionWiFiMax + dnsTelegramMax +
+                                  tcpTelegramMax + tlsTelegramMax + respuestaTelegramMax;
+
+// Nodo de sensores (periodoAlarma, periodoMuestreo y latidoAlarma de su muestreo.h)
+static const int periodoAlarmaSensor = 100;     // ms entre comprobaciones del LDR
+static const int periodoMuestreoSensor = 1000;  // ms entre muestras del planificador
+static const int latidoAlarmaSensor = 5000;     // ms entre repeticiones de una alarma activa
+
+static const int margenAlarma = 50;  // notificación, aire y tarea del actuador (unos ms en total)
+/// Latencia máxima del cruce de lumAlarma a la salida del actuador con ESP-NOW activo (ms).
+static const int cotaAlarma = periodoAlarmaSensor + reintentosAlarma * separacionReintentos + margenAlarma;
+/// Latencia máxima si el cruce llega con la ventana WiFi abierta (ms).
+static const int cotaAlarmaVentana = cotaAlarma + ventanaWiFiMax + latidoAlarmaSensor + periodoMuestreoSensor;
+
+inline ComandoGrupo comandoCritico = {TIPO_COMANDO_CRITICO, NUM_ACTUADORES, 0, {0}};
+
+inline TaskHandle_t AlarmaCriticaTask = NULL;
+inline volatile bool alarmaCritica = false;     // Estado según la última trama del sensor
+inline volatile bool alarmaPendiente = false;   // Cambio aún no enviado
+inline volatile int64_t alarmaDeteccionUs = 0;  // esp_timer_get_time() de la detección
+
+/**
+ * @brief Evalúa la condición crítica de una lectura y despierta al canal si cambia.
+ *
+ * Se llama desde OnDataRecv con cada trama del sensor que trae luz válida. La
+ * alarma se activa por encima de lumAlarma y solo se desactiva por debajo de
+ * lumAlarma - histeresisAlarma, para que el ruido del LDR no la haga parpadear.
+ * @return true si cambió el estado.
+ */
+inline bool alarmaEvaluar(const ConfigBlob *cfg, int lum) {
+  bool critica = alarmaCritica ? lum > cfg->lumAlarma - histeresisAlarma : lum > cfg->lumAlarma;
+  if (critica == alarmaCritica) {
+    return false;
+  }
+  alarmaDeteccionUs = esp_timer_get_time();
+  alarmaCritica = critica;
+  alarmaPendiente = true;
+  if (AlarmaCriticaTask != NULL) {
+    xTaskNotifyGive(AlarmaCriticaTask);
+  }
+  return true;
+}
+
+/**
+ * @brief Desactiva la alarma si la última luz del sensor ya no es usable.
+ *
+ * tareaAlarmaCritica la llama en cada ciclo: sin tramas con luz válida en
+ * maxEdadLectura no hay con qué sostener la alarma, y el canal crítico pasa a
+ * enviar su fin. Cuenta la edad de la última luz buena: una trama suelta con
+ * el LDR inválido no apaga el fuego.
+ * @return true si la desactivó.
+ */
+inline bool alarmaCaducar(const Lecturas &l, uint32_t ahoraMs) {
+  Lecturas ultimaLuz = l;
+  ultimaLuz.validez = VALIDO_LUM;
+  if (!alarmaCritica || lecturasUsables(ultimaLuz, ahoraMs)) {
+    return false;
+  }
+  alarmaDeteccionUs = esp_timer_get_time();
+  alarmaCritica = false;
+  alarmaPendiente = true;
+  return true;
+}
+
+/**
+ * @brief Indica si se puede apagar ESP-NOW para abrir la ventana WiFi.
+ *
+ * Con la alarma activa o un cambio sin enviar, este nodo tiene que seguir
+ * oyendo al sensor y repitiendo el estado a los actuadores.
+ */
+inline bool ventanaWiFiPermitida() {
+  return !alarmaCritica && !alarmaPendiente;
+}
+
+/**
+ * @brief Rellena la trama crítica con el estado actual y avanza su secuencia.
+ * @return Bits de salida enviados a cada actuador.
+ */
+inline uint8_t alarmaArmarTrama(ComandoGrupo *c) {
+  uint8_t bits = alarmaCritica ? SAL_ALARMA : 0;
+  for (int i = 0; i < NUM_ACTUADORES; i++) {
+    c->salidas[i] = bits;
+  }
+  c->secuencia++;
+  return bits;
+}
+
+#endif
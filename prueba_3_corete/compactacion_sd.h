@@ -0,0 +1,552 @@
+/**
+ * @file compactacion_sd.h
+ * @brief Compactación y retención de los CSV por hora de la tarjeta SD.
+ *
+ * Una vez por hora, la tarea Compactador (en el sketch) reúne las horas de
+ * cada día cerrado en /YYYY-MM-DD/data.csv con una línea "# resumen" por hora,
+ * promedia a 1 minuto los días con más de diasDiezmado y borra los que pasan
+ * de diasRetencion. El día se reconstruye en data.tmp, que termina en "# fin"
+ * y se renombra al final, así que un corte de corriente no pierde ni duplica
+ * datos. Si falla una lectura o una escritura (tarjeta llena) se borra
+ * data.tmp y se conservan los originales. sdMutex se cede cada
+ * lineasPorTramo operaciones.
+ *
+ * El día en curso no se compacta, ni siquiera sus horas ya cerradas: se queda
+ * en archivos por hora hasta la primera pasada tras la medianoche (según
+ * relojEpoch). Así nunca se reescribe un día al que logSensorData aún puede
+ * añadir filas, a costa de tener como mucho un día sin resúmenes; el
+ * importador ya une días a medio compactar.
+ */
+#ifndef CENTRAL_COMPACTACION_SD_H
+#define CENTRAL_COMPACTACION_SD_H
+
+#include <Arduino.h>
+#include <SD.h>
+#include "registro_sd.h"
+#include "reloj.h"
+
+static const uint32_t diasDiezmado = 7;             // días tras los que se promedia a 1 minuto
+static const uint32_t diasRetencion = 90;           // días tras los que se borra
+static const uint32_t lineasPorTramo = 64;          // operaciones por toma de sdMutex
+static const uint32_t pausaTramo = 20;              // ms entre tramos
+
+#define MAX_DIAS_PASADA 128
+#define DIEZMADO_NODOS 4
+#define MARCA_FIN "# fin"
+#define RESOLUCION_MINUTO "# resolucion 60 s"
+#define CABECERA_CSV "timestamp,nodeId,rssi,temp,hum,light,co2ppm,soilMoisture"
+
+inline uint32_t tramoInicio = 0;
+inline uint32_t tramoOperaciones = 0;
+inline bool compactacionFallo = false;  // Lectura o escritura fallida en el día en curso
+
+/**
+ * @brief Toma sdMutex para un tramo de compactación.
+ */
+inline void tramoTomar() {
+    xSemaphoreTake(sdMutex, portMAX_DELAY);
+    tramoInicio = micros();
+    tramoOperaciones = 0;
+}
+
+/**
+ * @brief Suelta sdMutex, registra cuánto se retuvo y pausa pausaTramo.
+ */
+inline void tramoSoltar() {
+    uint32_t d = micros() - tramoInicio;
+    xSemaphoreGive(sdMutex);
+    usoSD.tramos++;
+    usoSD.retenidoUs += d;
+    if (d > usoSD.tramoMaxUs) {
+        usoSD.tramoMaxUs = d;
+    }
+    vTaskDelay(pausaTramo / portTICK_PERIOD_MS);
+}
+
+/**
+ * @brief Cuenta una operación de SD y cede sdMutex cada lineasPorTramo.
+ */
+inline void tramoOperacion() {
+    if (++tramoOperaciones >= lineasPorTramo) {
+        tramoSoltar();
+        tramoTomar();
+    }
+}
+
+/**
+ * @brief Lee un archivo por bloques y lo entrega línea a línea.
+ */
+typedef struct LectorLineas {
+    File f;
+    char buf[512];
+    size_t ini;
+    size_t fin;
+} LectorLineas;
+
+/**
+ * @brief Siguiente línea sin '\r' ni '\n'; las demasiado largas se recortan.
+ * @return false al llegar al final del archivo.
+ */
+inline bool leerLinea(LectorLineas *l, char *linea, size_t n) {
+    size_t k = 0;
+    while (true) {
+        if (l->ini == l->fin) {
+            int leidos = l->f.read((uint8_t *) l->buf, sizeof(l->buf));
+            if (leidos <= 0) {
+                linea[k] = '\0';
+                return k > 0;
+            }
+            l->ini = 0;
+            l->fin = leidos;
+            usoSD.bytesLeidos += leidos;
+        }
+        char ch = l->buf[l->ini++];
+        if (ch == '\n') {
+            break;
+        }
+        if (ch != '\r' && k + 1 < n) {
+            linea[k++] = ch;
+        }
+    }
+    linea[k] = '\0';
+    return true;
+}
+
+/**
+ * @brief Escribe una línea y la suma al volumen escrito.
+ *
+ * Una escritura corta (tarjeta llena o retirada) marca compactacionFallo.
+ */
+inline void escribirLinea(File &f, const char *linea) {
+    size_t n = f.println(linea);
+    usoSD.bytesEscritos += n;
+    if (n != strlen(linea) + 2) {
+        compactacionFallo = true;
+    }
+}
+
+/**
+ * @brief Abre un archivo para leerlo; si existe y no se puede abrir marca compactacionFallo.
+ */
+inline void lectorAbrir(LectorLineas *l, const char *ruta) {
+    l->f = SD.open(ruta);
+    l->ini = l->fin = 0;
+    if (!l->f && SD.exists(ruta)) {
+        compactacionFallo = true;
+    }
+}
+
+/**
+ * @brief Una línea de datos del CSV.
+ */
+typedef struct FilaCSV {
+    char minuto[17];   ///< "YYYY-MM-DD hh:mm"
+    char nodo[12];
+    int rssi;
+    float v[5];        ///< temp, hum, light, co2ppm, soilMoisture
+} FilaCSV;
+
+/**
+ * @brief Parsea una línea escrita por formatearLineaCSV.
+ * @return false para la cabecera, comentarios o líneas dañadas.
+ */
+inline bool parsearLineaCSV(const char *linea, FilaCSV *f) {
+    if (strlen(linea) < 21 || linea[19] != ',' || linea[0] < '0' || linea[0] > '9') {
+        return false;
+    }
+    memcpy(f->minuto, linea, 16);
+    f->minuto[16] = '\0';
+    const char *p = linea + 20;
+    const char *coma = strchr(p, ',');
+    if (coma == NULL || (size_t) (coma - p) >= sizeof(f->nodo)) {
+        return false;
+    }
+    memcpy(f->nodo, p, coma - p);
+    f->nodo[coma - p] = '\0';
+    char *e;
+    f->rssi = strtol(coma + 1, &e, 10);
+    for (int i = 0; i < 5; i++) {
+        if (*e != ',') {
+            return false;
+        }
+        f->v[i] = strtof(e + 1, &e);
+    }
+    return *e == '\0';
+}
+
+/**
+ * @brief Mínimo, media y máximo de cada campo en una hora.
+ */
+typedef struct ResumenHora {
+    uint32_t n;
+    float min[5];
+    float max[5];
+    double suma[5];
+} ResumenHora;
+
+inline void resumenAgregar(ResumenHora *r, const FilaCSV *f) {
+    for (int i = 0; i < 5; i++) {
+        if (r->n == 0 || f->v[i] < r->min[i]) {
+            r->min[i] = f->v[i];
+        }
+        if (r->n == 0 || f->v[i] > r->max[i]) {
+            r->max[i] = f->v[i];
+        }
+        r->suma[i] += f->v[i];
+    }
+    r->n++;
+}
+
+/**
+ * @brief "# resumen YYYY-MM-DD HH n=... temp=min/media/max ..." (los campos solo si n > 0).
+ */
+inline int formatearResumen(char *buf, size_t n, const char *dia, int hora, const ResumenHora *r) {
+    static const char *const nombres[5] = {"temp", "hum", "light", "co2ppm", "soilMoisture"};
+    int k = snprintf(buf, n, "# resumen %s %02d n=%u", dia, hora, (unsigned) r->n);
+    for (int i = 0; i < 5 && r->n > 0 && k > 0 && (size_t) k < n; i++) {
+        k += snprintf(buf + k, n - k, " %s=%.2f/%.2f/%.2f", nombres[i],
+                      r->min[i], r->suma[i] / r->n, r->max[i]);
+    }
+    return k;
+}
+
+/**
+ * @brief Acumulador de un minuto para un nodo.
+ */
+typedef struct Cubeta {
+    char minuto[17];
+    char nodo[12];
+    uint32_t n;
+    double rssi;
+    double suma[5];
+} Cubeta;
+
+/**
+ * @brief Promedia las líneas a una por minuto y nodo (hasta DIEZMADO_NODOS a la vez).
+ */
+typedef struct Diezmador {
+    Cubeta c[DIEZMADO_NODOS];
+} Diezmador;
+
+inline void diezmadorVaciar(Cubeta *c, File &dst) {
+    if (c->n == 0) {
+        return;
+    }
+    char linea[96];
+    snprintf(linea, sizeof(linea), "%s:00,%s,%d,%.2f,%.2f,%u,%.2f,%.2f",
+             c->minuto, c->nodo, (int) lround(c->rssi / c->n),
+             c->suma[0] / c->n, c->suma[1] / c->n, (unsigned) lround(c->suma[2] / c->n),
+             c->suma[3] / c->n, c->suma[4] / c->n);
+    escribirLinea(dst, linea);
+    c->n = 0;
+}
+
+inline void diezmadorVaciarTodo(Diezmador *d, File &dst) {
+    for (int i = 0; i < DIEZMADO_NODOS; i++) {
+        diezmadorVaciar(&d->c[i], dst);
+    }
+}
+
+inline void diezmadorAgregar(Diezmador *d, const FilaCSV *f, File &dst) {
+    Cubeta *c = NULL;
+    for (int i = 0; i < DIEZMADO_NODOS && c == NULL; i++) {
+        if (d->c[i].n > 0 && strcmp(d->c[i].nodo, f->nodo) == 0) {
+            c = &d->c[i];
+        }
+    }
+    for (int i = 0; i < DIEZMADO_NODOS && c == NULL; i++) {
+        if (d->c[i].n == 0) {
+            c = &d->c[i];
+        }
+    }
+    if (c == NULL) {
+        // Más nodos que cubetas: se cierra la primera antes de tiempo
+        c = &d->c[0];
+        diezmadorVaciar(c, dst);
+    }
+    if (c->n > 0 && strcmp(c->minuto, f->minuto) != 0) {
+        diezmadorVaciar(c, dst);
+    }
+    if (c->n == 0) {
+        strcpy(c->minuto, f->minuto);
+        strcpy(c->nodo, f->nodo);
+        c->rssi = 0;
+        memset(c->suma, 0, sizeof(c->suma));
+    }
+    c->rssi += f->rssi;
+    for (int i = 0; i < 5; i++) {
+        c->suma[i] += f->v[i];
+    }
+    c->n++;
+}
+
+/**
+ * @brief Indica si el archivo termina en MARCA_FIN (se escribió completo).
+ */
+inline bool archivoTerminado(const char *ruta) {
+    File f = SD.open(ruta);
+    if (!f) {
+        return false;
+    }
+    const size_t n = sizeof(MARCA_FIN) + 1;  // marca y "\r\n"
+    char cola[n];
+    bool ok = f.size() >= n && f.seek(f.size() - n) &&
+              f.read((uint8_t *) cola, n) == (int) n &&
+              memcmp(cola, MARCA_FIN "\r\n", n) == 0;
+    f.close();
+    return ok;
+}
+
+/**
+ * @brief Indica si el data.csv de un día ya está promediado a 1 minuto.
+ */
+inline bool diaDiezmado(const char *ruta) {
+    LectorLineas l;
+    l.f = SD.open(ruta);
+    l.ini = l.fin = 0;
+    if (!l.f) {
+        return false;
+    }
+    char linea[32];
+    bool ok = leerLinea(&l, linea, sizeof(linea)) && strcmp(linea, RESOLUCION_MINUTO) == 0;
+    l.f.close();
+    return ok;
+}
+
+/**
+ * @brief Indica si el día tiene carpetas de hora o un data.tmp pendiente.
+ */
+inline bool diaConPendientes(const char *dia) {
+    char ruta[16];
+    snprintf(ruta, sizeof(ruta), "/%s", dia);
+    File d = SD.open(ruta);
+    bool pendiente = false;
+    for (File f = d.openNextFile(); f && !pendiente; f = d.openNextFile()) {
+        const char *nombre = f.name();
+        pendiente = f.isDirectory() || strstr(nombre, "data.tmp") != NULL;
+        f.close();
+        tramoOperacion();
+    }
+    d.close();
+    return pendiente;
+}
+
+/**
+ * @brief Reconstruye /dia/data.csv con el data.csv previo y las horas sueltas.
+ *
+ * Las horas que ya tienen "# resumen" en data.csv no se vuelven a añadir, lo
+ * que hace que repetir la compactación tras un corte sea inocuo.
+ * @param diezmar Promediar las líneas a 1 minuto.
+ * @return true si se sustituyó data.csv.
+ */
+inline bool compactarDia(const char *dia, bool diezmar) {
+    char ruta[32];
+    char tmp[32];
+    char linea[256];
+    snprintf(ruta, sizeof(ruta), "/%s/data.csv", dia);
+    snprintf(tmp, sizeof(tmp), "/%s/data.tmp", dia);
+
+    // Recuperar una reconstrucción que se cortó entre borrar data.csv y renombrar
+    if (SD.exists(tmp)) {
+        if (!SD.exists(ruta) && archivoTerminado(tmp)) {
+            SD.rename(tmp, ruta);
+        } else {
+            SD.remove(tmp);
+        }
+        tramoOperacion();
+    }
+
+    File dst = SD.open(tmp, FILE_WRITE);
+    if (!dst) {
+        Serial.println("❌ No se pudo crear el archivo de compactación.");
+        return false;
+    }
+    compactacionFallo = false;
+    escribirLinea(dst, diezmar ? RESOLUCION_MINUTO : "# resolucion original");
+    escribirLinea(dst, CABECERA_CSV);
+
+    Diezmador dz;
+    memset(&dz, 0, sizeof(dz));
+    FilaCSV fila;
+    uint32_t horasIncluidas = 0;  // bit h: data.csv ya tenía el resumen de la hora h
+
+    LectorLineas l;
+    lectorAbrir(&l, ruta);
+    if (l.f) {
+        while (leerLinea(&l, linea, sizeof(linea))) {
+            tramoOperacion();
+            if (linea[0] == '#') {
+                // Resolución y marca de fin se regeneran; los resúmenes se conservan
+                int h;
+                if (sscanf(linea, "# resumen %*10s %d", &h) == 1 && h >= 0 && h < 24) {
+                    horasIncluidas |= 1UL << h;
+                    diezmadorVaciarTodo(&dz, dst);
+                    escribirLinea(dst, linea);
+                }
+            } else if (parsearLineaCSV(linea, &fila)) {
+                if (diezmar) {
+                    diezmadorAgregar(&dz, &fila, dst);
+                } else {
+                    escribirLinea(dst, linea);
+                }
+            }
+        }
+        l.f.close();
+    }
+
+    uint32_t horasSueltas = 0;
+    for (int h = 0; h < 24; h++) {
+        char hora[32];
+        snprintf(hora, sizeof(hora), "/%s/%02d", dia, h);
+        tramoOperacion();
+        if (!SD.exists(hora)) {
+            continue;
+        }
+        horasSueltas |= 1UL << h;
+        if (horasIncluidas & (1UL << h)) {
+            continue;
+        }
+        strcat(hora, "/data.csv");
+        ResumenHora resumen;
+        memset(&resumen, 0, sizeof(resumen));
+        lectorAbrir(&l, hora);
+        if (l.f) {
+            while (leerLinea(&l, linea, sizeof(linea))) {
+                tramoOperacion();
+                if (!parsearLineaCSV(linea, &fila)) {
+                    continue;
+                }
+                resumenAgregar(&resumen, &fila);
+                if (diezmar) {
+                    diezmadorAgregar(&dz, &fila, dst);
+                } else {
+                    escribirLinea(dst, linea);
+                }
+            }
+            l.f.close();
+        }
+        diezmadorVaciarTodo(&dz, dst);
+        formatearResumen(linea, sizeof(linea), dia, h, &resumen);
+        escribirLinea(dst, linea);
+    }
+    diezmadorVaciarTodo(&dz, dst);
+    escribirLinea(dst, MARCA_FIN);
+    dst.close();
+
+    // Sin la reconstrucción completa no se toca nada de lo que ya había
+    if (compactacionFallo || !archivoTerminado(tmp)) {
+        SD.remove(tmp);
+        Serial.printf("❌ Compactación de %s incompleta (¿SD llena?); se conservan los originales.\n", dia);
+        return false;
+    }
+    SD.remove(ruta);
+    if (!SD.rename(tmp, ruta)) {
+        Serial.println("❌ No se pudo renombrar el archivo compactado.");
+        return false;
+    }
+    for (int h = 0; h < 24; h++) {
+        if (horasSueltas & (1UL << h)) {
+            snprintf(linea, sizeof(linea), "/%s/%02d/data.csv", dia, h);
+            SD.remove(linea);
+            linea[strlen(linea) - strlen("/data.csv")] = '\0';
+            SD.rmdir(linea);
+            tramoOperacion();
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Borra un día entero: horas sueltas, data.csv, data.tmp y la carpeta.
+ */
+inline void borrarDia(const char *dia) {
+    char ruta[32];
+    for (int h = 0; h < 24; h++) {
+        snprintf(ruta, sizeof(ruta), "/%s/%02d", dia, h);
+        if (SD.exists(ruta)) {
+            strcat(ruta, "/data.csv");
+            SD.remove(ruta);
+            ruta[strlen(ruta) - strlen("/data.csv")] = '\0';
+            SD.rmdir(ruta);
+        }
+        tramoOperacion();
+    }
+    snprintf(ruta, sizeof(ruta), "/%s/data.csv", dia);
+    SD.remove(ruta);
+    snprintf(ruta, sizeof(ruta), "/%s/data.tmp", dia);
+    SD.remove(ruta);
+    snprintf(ruta, sizeof(ruta), "/%s", dia);
+    SD.rmdir(ruta);
+    tramoOperacion();
+}
+
+/**
+ * @brief Número de día (días desde 1970) de un nombre "YYYY-MM-DD", o -1 si no lo es.
+ */
+inline int32_t numeroDia(const char *nombre) {
+    int y, m, d;
+    if (strlen(nombre) != 10 || nombre[4] != '-' || nombre[7] != '-' ||
+        sscanf(nombre, "%4d-%2d-%2d", &y, &m, &d) != 3 || y < 2000 || m < 1 || m > 12 || d < 1 || d > 31) {
+        return -1;
+    }
+    return diasDesdeCivil(y, m, d);
+}
+
+/**
+ * @brief Una pasada de compactación y retención sobre todos los días cerrados.
+ */
+inline void compactarSD() {
+    static char dias[MAX_DIAS_PASADA][11];
+    uint32_t t0 = millis();
+    int32_t hoy = relojEpoch() / 86400;
+    int nd = 0;
+    int compactados = 0;
+    int borrados = 0;
+
+    tramoTomar();
+    File raiz = SD.open("/");
+    for (File f = raiz.openNextFile(); f && nd < MAX_DIAS_PASADA; f = raiz.openNextFile()) {
+        const char *nombre = f.name();
+        if (nombre[0] == '/') {
+            nombre++;
+        }
+        if (f.isDirectory() && numeroDia(nombre) >= 0) {
+            strcpy(dias[nd++], nombre);  // numeroDia ya comprobó que mide 10
+        }
+        f.close();
+        tramoOperacion();
+    }
+    raiz.close();
+
+    for (int i = 0; i < nd; i++) {
+        int32_t edad = hoy - numeroDia(dias[i]);
+        if (edad < 1) {
+            continue;  // día en curso (o reloj atrasado): se compacta tras la medianoche
+        }
+        if ((uint32_t) edad >= diasRetencion) {
+            borrarDia(dias[i]);
+            borrados++;
+            continue;
+        }
+        char ruta[32];
+        snprintf(ruta, sizeof(ruta), "/%s/data.csv", dias[i]);
+        bool diezmar = (uint32_t) edad >= diasDiezmado;
+        if (diaConPendientes(dias[i]) || (diezmar && !diaDiezmado(ruta))) {
+            compactados += compactarDia(dias[i], diezmar);
+        }
+    }
+    tramoSoltar();
+
+    uint32_t duracion = millis() - t0;
+    Serial.printf("Compactación SD: %d días compactados, %d borrados en %u ms; leídos %u B, escritos %u B\n",
+                  compactados, borrados, (unsigned) duracion,
+                  (unsigned) usoSD.bytesLeidos, (unsigned) usoSD.bytesEscritos);
+    Serial.printf("sdMutex: %u tramos, retención máx %u us (%.1f%% de la pasada); "
+                  "logSensorData máx %u us, espera máx %u us\n",
+                  (unsigned) usoSD.tramos, (unsigned) usoSD.tramoMaxUs,
+                  duracion ? usoSD.retenidoUs / (10.0 * duracion) : 0.0,
+                  (unsigned) usoSD.registroMaxUs, (unsigned) usoSD.esperaMaxUs);
+    memset(&usoSD, 0, sizeof(usoSD));
+}
+
+#endif
@@ -0,0 +1,211 @@
+/**
+ * @file config_blob.h
+ * @brief Formato de la configuración recargable (ConfigBlob) y su validación.
+ *
+ * Es el único ejemplar: los sketches de sensores y actuadores, las pruebas y
+ * generador_config lo incluyen desde aquí, así que los tres nodos comparten
+ * formato y firma. En el ESP32 el CRC sale de la ROM y la firma de mbedtls;
+ * en el PC de zlib y OpenSSL, que dan los mismos valores.
+ *
+ * El CRC solo detecta daños. Lo que impide que cualquiera con un ESP32 cambie
+ * MACs y umbrales es la firma: un HMAC-SHA256 con la clave CFG_CLAVE,
+ * compartida por los nodos y el generador, que además solo aceptan
+ * configuraciones del nodo central (ver cfgEvaluar).
+ */
+#ifndef CENTRAL_CONFIG_BLOB_H
+#define CENTRAL_CONFIG_BLOB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef ARDUINO
+#include "esp_rom_crc.h"
+#include "mbedtls/md.h"
+#else
+#include <zlib.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#endif
+
+#define CFG_MAGIC 0x43564E49      // "INVC"
+#define CFG_VERSION 2
+#define CFG_TAM_RANURA 4096       // Un sector de flash por ranura
+#define CFG_INTERVALO_MIN_MS 5000 // Tiempo mínimo entre dos conmutaciones
+#define CFG_TAM_FIRMA 16          // Bytes del HMAC-SHA256 que se guardan
+
+/// Clave de las firmas: se fija al compilar con -DCFG_CLAVE=\"...\" (en Arduino,
+/// compiler.cpp.extra_flags). Sin valor por defecto: una clave publicada en el
+/// repositorio no protege nada.
+#ifndef CFG_CLAVE
+#error "Define CFG_CLAVE con la clave de las configuraciones (-DCFG_CLAVE=\"...\")"
+#endif
+
+/**
+ * @brief Configuración de red y umbrales, tal como se guarda en flash.
+ *
+ * Se lee en sitio desde la partición "invcfg" mapeada en memoria, sin parseo.
+ * La partición tiene dos ranuras: la configuración nueva se escribe en la
+ * inactiva y después se conmuta el puntero cfgActiva.
+ */
+typedef struct __attribute__((packed)) ConfigBlob {
+  uint32_t magic;            ///< CFG_MAGIC
+  uint16_t version;          ///< CFG_VERSION
+  uint16_t longitud;         ///< sizeof(ConfigBlob)
+  uint32_t generacion;       ///< Crece con cada configuración publicada
+  uint8_t macSensores[6];    ///< Nodo de sensores
+  uint8_t macActuadores[6];  ///< Nodo de actuadores
+  uint8_t macNucleoC[6];     ///< Nodo central
+  uint8_t reservado[2];
+  float tempMax;             ///< Ventilador por encima (°C)
+  float tempMin;             ///< Calefacción por debajo (°C)
+  float humMax;              ///< Ventilador por encima (%)
+  float co2Max;              ///< Ventilador por encima (ppm)
+  uint16_t lumAlarma;        ///< Alarma de fuego por encima (valor ADC)
+  uint16_t lumLed;           ///< LED de cultivo por debajo (valor ADC)
+  float humSueloMin;         ///< Bomba por debajo (%)
+  uint32_t crc;              ///< CRC32 de todos los campos anteriores
+  uint8_t firma[CFG_TAM_FIRMA];  ///< HMAC-SHA256 (truncado) de todos los campos anteriores
+} ConfigBlob;
+
+/// Valores de compilación, usados si la flash no tiene una configuración válida.
+static const ConfigBlob cfgPorDefecto = {
+  CFG_MAGIC, CFG_VERSION, sizeof(ConfigBlob), 0,
+  {0xE0, 0x5A, 0x1B, 0x95, 0x25, 0xD4},
+  {0x88, 0x13, 0xBF, 0x07, 0xF7, 0xC0}, //88:13:bf:07:f7:c0
+  {0xC8, 0xF0, 0x9E, 0x7B, 0x78, 0x88},
+  {0, 0},
+  28, 18, 60, 1800, 3500, 2500, 60,
+  0, {0}
+};
+
+/**
+ * @brief Calcula el CRC32 de una configuración (sin incluir el propio campo crc).
+ */
+inline uint32_t cfgCalcularCRC(const ConfigBlob *c) {
+#ifdef ARDUINO
+  return esp_rom_crc32_le(0, (const uint8_t *) c, offsetof(ConfigBlob, crc));
+#else
+  return crc32(0, (const Bytef *) c, offsetof(ConfigBlob, crc));
+#endif
+}
+
+/**
+ * @brief Calcula la firma de una configuración (sin incluir el propio campo firma).
+ * @param clave Clave del HMAC, terminada en '\\0'.
+ */
+inline void cfgCalcularFirma(const ConfigBlob *c, const char *clave, uint8_t firma[CFG_TAM_FIRMA]) {
+  uint8_t hmac[32];
+#ifdef ARDUINO
+  mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                  (const uint8_t *) clave, strlen(clave),
+                  (const uint8_t *) c, offsetof(ConfigBlob, firma), hmac);
+#else
+  unsigned int n = sizeof(hmac);
+  HMAC(EVP_sha256(), clave, (int) strlen(clave),
+       (const unsigned char *) c, offsetof(ConfigBlob, firma), hmac, &n);
+#endif
+  memcpy(firma, hmac, CFG_TAM_FIRMA);
+}
+
+/**
+ * @brief Rellena cabecera, CRC y firma de una configuración ya con sus datos.
+ */
+inline void cfgFirmar(ConfigBlob *c, const char *clave = CFG_CLAVE) {
+  c->magic = CFG_MAGIC;
+  c->version = CFG_VERSION;
+  c->longitud = sizeof(ConfigBlob);
+  c->crc = cfgCalcularCRC(c);
+  cfgCalcularFirma(c, clave, c->firma);
+}
+
+/**
+ * @brief Comprueba cabecera, CRC y firma de una configuración.
+ */
+inline bool cfgEsValida(const ConfigBlob *c) {
+  if (c->magic != CFG_MAGIC || c->version != CFG_VERSION ||
+      c->longitud != sizeof(ConfigBlob) || c->crc != cfgCalcularCRC(c)) {
+    return false;
+  }
+  uint8_t firma[CFG_TAM_FIRMA];
+  cfgCalcularFirma(c, CFG_CLAVE, firma);
+  uint8_t diferencia = 0;  // Comparación de tiempo constante
+  for (int i = 0; i < CFG_TAM_FIRMA; i++) {
+    diferencia |= firma[i] ^ c->firma[i];
+  }
+  return diferencia == 0;
+}
+
+/**
+ * @brief Resultado de cfgEvaluar para un mensaje recibido.
+ */
+typedef enum CfgVeredicto {
+  CFG_NO_ES_CONFIG,        ///< Otro tipo de mensaje
+  CFG_ACEPTADA,            ///< Copiada en nueva
+  CFG_ORIGEN_DESCONOCIDO,  ///< No viene del nodo central
+  CFG_INVALIDA,            ///< Cabecera, CRC o firma incorrectos
+  CFG_ANTIGUA              ///< Generación no posterior a la activa
+} CfgVeredicto;
+
+/**
+ * @brief Decide si un mensaje es una configuración aceptable.
+ * @param origen MAC del remitente, o NULL si llegó por el puerto serie.
+ * @param activa Configuración en uso (da la MAC del nodo central y la generación).
+ * @param nueva Destino de la configuración si se acepta.
+ */
+inline CfgVeredicto cfgEvaluar(const uint8_t *datos, int len, const uint8_t *origen,
+                               const ConfigBlob *activa, ConfigBlob *nueva) {
+  if (len != sizeof(ConfigBlob)) {
+    return CFG_NO_ES_CONFIG;
+  }
+  memcpy(nueva, datos, sizeof(ConfigBlob));
+  if (nueva->magic != CFG_MAGIC) {
+    return CFG_NO_ES_CONFIG;
+  }
+  if (origen != NULL && memcmp(origen, activa->macNucleoC, 6) != 0) {
+    return CFG_ORIGEN_DESCONOCIDO;
+  }
+  if (!cfgEsValida(nueva)) {
+    return CFG_INVALIDA;
+  }
+  if (nueva->generacion <= activa->generacion) {
+    return CFG_ANTIGUA;
+  }
+  return CFG_ACEPTADA;
+}
+
+/**
+ * @brief Escribe una configuración en hexadecimal (2 * sizeof(ConfigBlob) caracteres).
+ */
+inline void cfgAHex(const ConfigBlob *c, char *buf, size_t n) {
+  static const char digitos[] = "0123456789abcdef";
+  const uint8_t *p = (const uint8_t *) c;
+  size_t k = 0;
+  for (size_t i = 0; i < sizeof(ConfigBlob) && k + 2 < n; i++) {
+    buf[k++] = digitos[p[i] >> 4];
+    buf[k++] = digitos[p[i] & 0x0F];
+  }
+  if (n > 0) {
+    buf[k] = '\0';
+  }
+}
+
+/**
+ * @brief Lee una configuración escrita por cfgAHex.
+ * @return false si no son exactamente 2 * sizeof(ConfigBlob) dígitos hexadecimales.
+ */
+inline bool cfgDesdeHex(const char *hex, ConfigBlob *c) {
+  uint8_t *p = (uint8_t *) c;
+  for (size_t i = 0; i < 2 * sizeof(ConfigBlob); i++) {
+    char ch = hex[i];
+    int v = ch >= '0' && ch <= '9' ? ch - '0' :
+            ch >= 'a' && ch <= 'f' ? ch - 'a' + 10 :
+            ch >= 'A' && ch <= 'F' ? ch - 'A' + 10 : -1;
+    if (v < 0) {
+      return false;
+    }
+    p[i / 2] = (i % 2) ? (p[i / 2] | v) : (v << 4);
+  }
+  return hex[2 * sizeof(ConfigBlob)] == '\0';
+}
+
+#endif
@@ -0,0 +1,182 @@
+/**
+ * @file control.h
+ * @brief Tramas ESP-NOW del nodo central y decisión de actuadores.
+ *
+ * Funciones puras, sin radio ni tareas: se usan igual en el sketch que en las
+ * pruebas y benchmarks del PC.
+ */
+#ifndef CENTRAL_CONTROL_H
+#define CENTRAL_CONTROL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "config_blob.h"
+#include "lecturas.h"
+
+/**
+ * @brief Estructura de datos recibidos desde sensores.
+ */
+typedef struct struct_message{
+  float temperatura;
+  float humedad;
+  uint16_t luminosidad;  // entero
+  float vCO2;
+  float humedadSuelo;
+  uint8_t validez;       // bits VALIDO_*: campos con lectura reciente
+} struct_message;
+
+// Bits de validez de struct_message: VALIDO_* de lecturas.h
+
+/**
+ * @brief Estructura de datos enviados a los actuadores.
+ */
+typedef struct struct_message2 {
+  bool eVentilador;
+  bool eBomba;
+  bool eLed;
+  bool eAlarma;
+  bool eCalor;
+} struct_message2;
+
+//----------COMANDOS DE GRUPO-----------------------------------
+// Un solo broadcast lleva las salidas de todos los nodos de actuadores; cada
+// nodo toma el byte de su id (guardado en su NVS). El coste de envío no crece con el
+// número de placas.
+#define TIPO_COMANDO_GRUPO 0xA5
+#define MAX_ACTUADORES 64     // Límite por trama (cabe de sobra en 250 bytes)
+#define NUM_ACTUADORES 1      // Placas de relés instaladas (ids 0..NUM_ACTUADORES-1)
+
+// Bits de cada byte de salidas
+#define SAL_VENTILADOR (1 << 0)
+#define SAL_BOMBA      (1 << 1)
+#define SAL_LED        (1 << 2)
+#define SAL_ALARMA     (1 << 3)
+#define SAL_CALOR      (1 << 4)
+
+/**
+ * @brief Trama de comandos para un grupo de nodos de actuadores.
+ *
+ * Solo se transmiten los primeros numNodos bytes de salidas.
+ */
+typedef struct __attribute__((packed)) ComandoGrupo {
+  uint8_t tipo;                     ///< TIPO_COMANDO_GRUPO
+  uint8_t numNodos;                 ///< Entradas válidas en salidas[]
+  uint16_t secuencia;               ///< Crece con cada trama
+  uint8_t salidas[MAX_ACTUADORES];  ///< Bits SAL_* por id de nodo
+} ComandoGrupo;
+
+/**
+ * @brief Empaqueta los estados de un nodo en su byte de salidas.
+ */
+inline uint8_t empaquetarSalidas(const struct_message2 &m) {
+  return (m.eVentilador ? SAL_VENTILADOR : 0) | (m.eBomba ? SAL_BOMBA : 0) |
+         (m.eLed ? SAL_LED : 0) | (m.eAlarma ? SAL_ALARMA : 0) |
+         (m.eCalor ? SAL_CALOR : 0);
+}
+
+/**
+ * @brief Longitud en bytes de la trama de grupo a transmitir.
+ */
+inline size_t longitudComandoGrupo(const ComandoGrupo &c) {
+  return offsetof(ComandoGrupo, salidas) + c.numNodos;
+}
+
+/**
+ * @brief Decide el estado de cada actuador a partir de las lecturas.
+ * @param cfg Umbrales a aplicar.
+ * @param usables Bits VALIDO_* de los campos con lectura reciente.
+ * @return Estados a enviar al nodo de actuadores.
+ *
+ * Un campo sin lectura reciente no enciende nada: calefacción, bomba y LED
+ * quedan apagados y el ventilador solo depende de los campos que sí hay.
+ */
+inline struct_message2 calcularSalidas(const ConfigBlob *cfg, const Lecturas &l, uint8_t usables) {
+  bool t = usables & VALIDO_TEMP, h = usables & VALIDO_HUM, luz = usables & VALIDO_LUM;
+  bool co2 = usables & VALIDO_CO2, suelo = usables & VALIDO_SUELO;
+  struct_message2 salida;
+  salida.eVentilador = (t && l.temp > cfg->tempMax) || (h && l.hum > cfg->humMax) ||
+                       (co2 && l.CO2 > cfg->co2Max);
+  salida.eCalor = t && l.temp < cfg->tempMin;
+  salida.eAlarma = luz && l.lum > cfg->lumAlarma;
+  salida.eLed = luz && l.lum < cfg->lumLed;
+  salida.eBomba = suelo && l.valHumsuelo < cfg->humSueloMin;
+  return salida;
+}
+
+/**
+ * @brief Evalúa condiciones para activar actuadores y actualiza la trama de grupo.
+ * @param l Lecturas a evaluar.
+ * @param ahoraMs millis() actual, para la edad de cada campo.
+ * @param c Trama de grupo a rellenar; su secuencia avanza.
+ * @return Estados calculados.
+ *
+ * Hay un solo juego de sensores, así que todos los nodos reciben las mismas
+ * salidas; la trama admite un byte distinto por nodo.
+ */
+inline struct_message2 variablesEnvio(const ConfigBlob *cfg, const Lecturas &l, uint32_t ahoraMs, ComandoGrupo *c) {
+  struct_message2 salida = calcularSalidas(cfg, l, lecturasUsables(l, ahoraMs));
+  uint8_t bits = empaquetarSalidas(salida);
+  for (int i = 0; i < NUM_ACTUADORES; i++) {
+    c->salidas[i] = bits;
+  }
+  c->secuencia++;
+  return salida;
+}
+
+/**
+ * @brief Indica si alguna variable con lectura reciente está fuera de los umbrales.
+ * @param l Lecturas a evaluar.
+ * @param ahoraMs millis() actual, para la edad de cada campo.
+ */
+inline bool limitesSuperados(const ConfigBlob *cfg, const Lecturas &l, uint32_t ahoraMs) {
+  uint8_t u = lecturasUsables(l, ahoraMs);
+  return ((u & VALIDO_TEMP) && (l.temp > cfg->tempMax || l.temp < cfg->tempMin)) ||
+         ((u & VALIDO_HUM) && l.hum > cfg->humMax) ||
+         ((u & VALIDO_LUM) && (l.lum > cfg->lumAlarma || l.lum < cfg->lumLed)) ||
+         ((u & VALIDO_CO2) && l.CO2 >= cfg->co2Max) ||
+         ((u & VALIDO_SUELO) && l.valHumsuelo < cfg->humSueloMin);
+}
+
+/**
+ * @brief Formatea la lectura de sensores en formato JSON.
+ * @param buf Destino.
+ * @param n Tamaño de buf.
+ * @param fechaHora Fecha y hora de la lectura.
+ * @param temperaturaf Temperatura.
+ * @param humedadf Humedad relativa.
+ * @param luminosidadf Luminosidad.
+ * @param CO2f Concentración de CO2.
+ * @param humedadSuelof Humedad del suelo.
+ * @return Longitud del texto (como snprintf).
+ */
+inline int formatearLecturaSensores(char *buf, size_t n, const char *fechaHora, float temperaturaf, float humedadf,
+                                    uint16_t luminosidadf, float CO2f, float humedadSuelof) {
+  return snprintf(buf, n,
+           "{ \"fecha_hora\": \"%s\", \"temperatura\": %.2f, \"humedad\": %.2f, \"luminosidad\": %u, \"CO2\": %.2f, \"humedad_suelo\": %.2f }",
+           fechaHora, temperaturaf, humedadf, luminosidadf, CO2f, humedadSuelof);
+}
+
+/**
+ * @brief Formatea el mensaje de Telegram de límites superados.
+ * @param usables Bits VALIDO_* de los campos con lectura reciente; el resto sale como "--".
+ * @return Longitud del texto (como snprintf).
+ */
+inline int formatearMensajeAlarma(char *msg, size_t n, const Lecturas &l, uint8_t usables) {
+  char t[12] = "--", h[12] = "--", luz[12] = "--", co2[12] = "--";
+  if (usables & VALIDO_TEMP) snprintf(t, sizeof(t), "%.2f", l.temp);
+  if (usables & VALIDO_HUM) snprintf(h, sizeof(h), "%.2f", l.hum);
+  if (usables & VALIDO_LUM) snprintf(luz, sizeof(luz), "%d", l.lum);
+  if (usables & VALIDO_CO2) snprintf(co2, sizeof(co2), "%.2f", l.CO2);
+  return snprintf(msg, n,
+                  "‼️ ¡¡LÍMITE DE VARIABLES SUPERADO!!\n"
+                  "#INVERNADERO\n"
+                  "🌡 Temp: %s °C\n"
+                  "💧 Humedad: %s %%\n"
+                  "☀️ Luz: %s\n"
+                  "🌫 CO₂: %s PPM\n"
+                  "#FIN",
+                  t, h, luz, co2);
+}
+
+#endif
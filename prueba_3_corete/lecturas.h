@@ -0,0 +1,93 @@
+/**
+ * @file lecturas.h
+ * @brief Lecturas del nodo de sensores publicadas con un seqlock.
+ *
+ * OnDataRecv es el único escritor y pone lecturasVersion en impar mientras
+ * copia; los lectores repiten la copia si la versión era impar o cambió, sin
+ * bloquear nunca al escritor.
+ *
+ * Cada campo lleva su validez y la hora de su última lectura buena: las
+ * decisiones solo usan los campos que devuelve lecturasUsables().
+ */
+#ifndef CENTRAL_LECTURAS_H
+#define CENTRAL_LECTURAS_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+// Bits de validez de cada campo (deben coincidir con el nodo sensor)
+#define VALIDO_TEMP  (1 << 0)
+#define VALIDO_HUM   (1 << 1)
+#define VALIDO_LUM   (1 << 2)
+#define VALIDO_CO2   (1 << 3)
+#define VALIDO_SUELO (1 << 4)
+#define NUM_CAMPOS 5   // El campo i tiene el bit de validez 1 << i
+
+/// Edad máxima (ms) de una lectura para decidir con ella. El nodo de sensores
+/// envía al menos cada minuto: caben dos latidos perdidos.
+static const uint32_t maxEdadLectura = 150000;
+
+/**
+ * @brief Últimas lecturas del nodo de sensores.
+ */
+typedef struct Lecturas {
+  float temp;
+  float hum;
+  int lum;
+  float CO2;
+  float valHumsuelo;
+  uint32_t trama;                ///< Número de trama recibida (0 = ninguna todavía)
+  uint32_t marcaMs[NUM_CAMPOS];  ///< millis() de la última lectura válida de cada campo
+  uint8_t validez;               ///< VALIDO_*: campos válidos en la última trama
+} Lecturas;
+
+inline Lecturas lecturasPublicadas = {};
+inline std::atomic<uint32_t> lecturasVersion(0);
+inline std::atomic<uint32_t> lecturasReintentos(0);   // Copias repetidas por una escritura concurrente
+
+/**
+ * @brief Publica un juego de lecturas nuevo (solo desde OnDataRecv).
+ */
+inline void publicarLecturas(const Lecturas &nuevas) {
+  uint32_t v = lecturasVersion.load(std::memory_order_relaxed);
+  lecturasVersion.store(v + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy((void *) &lecturasPublicadas, &nuevas, sizeof(Lecturas));
+  lecturasVersion.store(v + 2, std::memory_order_release);
+}
+
+/**
+ * @brief Copia un juego de lecturas consistente (todas de la misma trama).
+ */
+inline Lecturas leerLecturas() {
+  Lecturas copia;
+  for (;;) {
+    uint32_t v1 = lecturasVersion.load(std::memory_order_acquire);
+    if ((v1 & 1) == 0) {
+      memcpy(&copia, (const void *) &lecturasPublicadas, sizeof(Lecturas));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (lecturasVersion.load(std::memory_order_relaxed) == v1) {
+        return copia;
+      }
+    }
+    lecturasReintentos.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+/**
+ * @brief Campos con los que se puede decidir: válidos en la última trama y
+ * leídos hace menos de maxEdadLectura.
+ * @return Bits VALIDO_*.
+ */
+inline uint8_t lecturasUsables(const Lecturas &l, uint32_t ahoraMs) {
+  uint8_t usables = 0;
+  for (int i = 0; i < NUM_CAMPOS; i++) {
+    if ((l.validez & (1 << i)) && ahoraMs - l.marcaMs[i] < maxEdadLectura) {
+      usables |= 1 << i;
+    }
+  }
+  return usables;
+}
+
+#endif
@@ -0,0 +1,194 @@
+/**
+ * @file perfil.h
+ * @brief Perfilador de tareas periódicas: periodo real, ocupación y pila libre.
+ *
+ * Cada tarea llama a perfilMarcar() al empezar su ciclo y encierra su trabajo
+ * entre perfilInicioTrabajo() y perfilFinTrabajo(). El uso de CPU por tarea
+ * sale de esas marcas con esp_timer, porque el core de Arduino se compila sin
+ * configGENERATE_RUN_TIME_STATS; es tiempo de pared, así que incluye las
+ * esperas dentro del trabajo y las expropiaciones. Si el core trae las
+ * estadísticas de FreeRTOS, perfilReportarCPU() imprime además las suyas.
+ *
+ * El nodo de actuadores lleva una copia que solo se distingue en la guarda.
+ */
+#ifndef CENTRAL_PERFIL_H
+#define CENTRAL_PERFIL_H
+
+#include <Arduino.h>
+#include "esp_timer.h"
+
+#define MAX_TAREAS_PERFIL 32
+static const uint32_t periodoPerfilador = 10000;  // ms entre reportes
+
+/**
+ * @brief Estadísticas de periodo y ocupación de una tarea periódica.
+ */
+typedef struct PerfilTarea {
+  const char *nombre;      ///< Nombre de la tarea
+  uint32_t pila;           ///< Bytes de pila asignados al crearla
+  uint32_t periodoMs;      ///< Periodo nominal
+  TaskHandle_t tarea;      ///< Handle devuelto al crearla
+  int64_t ultimo;          ///< us de la última marca
+  uint32_t ciclos;         ///< Periodos medidos desde el último reporte
+  int64_t sumaUs;
+  int64_t minUs;
+  int64_t maxUs;
+  uint32_t excesos;        ///< Periodos más de un 10 % por encima del nominal
+  int64_t inicioTrabajo;   ///< us de perfilInicioTrabajo (0 = fuera del trabajo)
+  int64_t ocupadoUs;       ///< Tiempo dentro del trabajo desde el último reporte
+  int64_t inicioVentana;   ///< us del último reporte (o de la primera marca)
+  int64_t ventanaUs;       ///< Duración de la ventana; solo en la copia de perfilTomar
+} PerfilTarea;
+
+inline portMUX_TYPE perfilMux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Perfil vacío de una tarea; el resto de campos empieza a cero.
+ */
+inline PerfilTarea perfilNuevo(const char *nombre, uint32_t pila, uint32_t periodoMs) {
+  PerfilTarea p = {};
+  p.nombre = nombre;
+  p.pila = pila;
+  p.periodoMs = periodoMs;
+  return p;
+}
+
+/**
+ * @brief Marca el inicio de un ciclo de la tarea y acumula el periodo medido.
+ */
+inline void perfilMarcar(PerfilTarea *p) {
+  int64_t ahora = esp_timer_get_time();
+  portENTER_CRITICAL(&perfilMux);
+  if (p->ultimo != 0) {
+    int64_t d = ahora - p->ultimo;
+    p->ciclos++;
+    p->sumaUs += d;
+    if (p->minUs == 0 || d < p->minUs) {
+      p->minUs = d;
+    }
+    if (d > p->maxUs) {
+      p->maxUs = d;
+    }
+    if (d > p->periodoMs * 1100LL) {
+      p->excesos++;
+    }
+  } else if (p->inicioVentana == 0) {
+    p->inicioVentana = ahora;
+  }
+  p->ultimo = ahora;
+  portEXIT_CRITICAL(&perfilMux);
+}
+
+/**
+ * @brief Marca el comienzo del trabajo de la tarea dentro de su ciclo.
+ */
+inline void perfilInicioTrabajo(PerfilTarea *p) {
+  int64_t ahora = esp_timer_get_time();
+  portENTER_CRITICAL(&perfilMux);
+  p->inicioTrabajo = ahora;
+  portEXIT_CRITICAL(&perfilMux);
+}
+
+/**
+ * @brief Marca el final del trabajo y acumula su duración.
+ */
+inline void perfilFinTrabajo(PerfilTarea *p) {
+  int64_t ahora = esp_timer_get_time();
+  portENTER_CRITICAL(&perfilMux);
+  if (p->inicioTrabajo != 0) {
+    p->ocupadoUs += ahora - p->inicioTrabajo;
+    p->inicioTrabajo = 0;
+  }
+  portEXIT_CRITICAL(&perfilMux);
+}
+
+/**
+ * @brief Copia las estadísticas de una tarea y reinicia sus contadores.
+ *
+ * Un trabajo en curso se parte: lo hecho hasta ahora cuenta en esta ventana
+ * y el resto en la siguiente.
+ */
+inline PerfilTarea perfilTomar(PerfilTarea *p) {
+  int64_t ahora = esp_timer_get_time();
+  portENTER_CRITICAL(&perfilMux);
+  if (p->inicioTrabajo != 0) {
+    p->ocupadoUs += ahora - p->inicioTrabajo;
+    p->inicioTrabajo = ahora;
+  }
+  PerfilTarea copia = *p;
+  p->ciclos = 0;
+  p->sumaUs = 0;
+  p->minUs = 0;
+  p->maxUs = 0;
+  p->excesos = 0;
+  p->ocupadoUs = 0;
+  p->inicioVentana = ahora;
+  portEXIT_CRITICAL(&perfilMux);
+  copia.ventanaUs = copia.inicioVentana != 0 ? ahora - copia.inicioVentana : 0;
+  return copia;
+}
+
+/**
+ * @brief Porcentaje del tiempo de la ventana que la tarea pasó en su trabajo.
+ * @param copia Resultado de perfilTomar.
+ */
+inline float perfilOcupacion(const PerfilTarea &copia) {
+  return copia.ventanaUs > 0 ? copia.ocupadoUs * 100.0f / copia.ventanaUs : 0;
+}
+
+/**
+ * @brief Imprime periodo, ocupación y pila libre de una tarea y reinicia sus contadores.
+ * @return Las estadísticas impresas.
+ */
+inline PerfilTarea perfilReportarPeriodo(PerfilTarea *p) {
+  PerfilTarea copia = perfilTomar(p);
+  unsigned libre = copia.tarea ? (unsigned) uxTaskGetStackHighWaterMark(copia.tarea) : 0;
+  Serial.printf("  %-12s pila %u/%u B libres, periodo %u ms: min/med/max %lld/%lld/%lld ms, excesos %u/%u, ocupada %.1f%%\n",
+                copia.nombre, libre, (unsigned) copia.pila, (unsigned) copia.periodoMs,
+                (long long) (copia.minUs / 1000),
+                (long long) (copia.ciclos ? copia.sumaUs / copia.ciclos / 1000 : 0),
+                (long long) (copia.maxUs / 1000), (unsigned) copia.excesos, (unsigned) copia.ciclos,
+                perfilOcupacion(copia));
+  return copia;
+}
+
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+/**
+ * @brief Imprime el uso de CPU y la pila libre de todas las tareas desde el último reporte.
+ *
+ * El porcentaje es sobre el tiempo de un núcleo, así que con dos núcleos la
+ * suma puede llegar a 200 %.
+ */
+inline void perfilReportarCPU() {
+  static TaskStatus_t estados[MAX_TAREAS_PERFIL];
+  static TaskHandle_t previoTarea[MAX_TAREAS_PERFIL];
+  static uint32_t previoContador[MAX_TAREAS_PERFIL];
+  static int numPrevio = 0;
+  static uint32_t previoTotal = 0;
+
+  uint32_t total;
+  int n = uxTaskGetSystemState(estados, MAX_TAREAS_PERFIL, &total);
+  uint32_t dTotal = total - previoTotal;
+  for (int i = 0; i < n; i++) {
+    uint32_t anterior = 0;
+    for (int j = 0; j < numPrevio; j++) {
+      if (previoTarea[j] == estados[i].xHandle) {
+        anterior = previoContador[j];
+        break;
+      }
+    }
+    float cpu = dTotal ? (estados[i].ulRunTimeCounter - anterior) * 100.0f / dTotal : 0;
+    Serial.printf("  %-12s cpu %5.1f%%, pila libre %u B\n",
+                  estados[i].pcTaskName, cpu, (unsigned) estados[i].usStackHighWaterMark);
+    previoTarea[i] = estados[i].xHandle;
+    previoContador[i] = estados[i].ulRunTimeCounter;
+  }
+  numPrevio = n;
+  previoTotal = total;
+}
+#define PERFIL_CPU_FREERTOS 1
+#else
+#define PERFIL_CPU_FREERTOS 0
+#endif
+
+#endif
@@ -19,6 +19,20 @@
 #include <WiFi.h>
 #include <Wire.h>
 #include <RTClib.h>
+#include <SD.h>
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include <atomic>
+#include "config_blob.h"
+#include "lecturas.h"
+#include "control.h"
+#include "reloj.h"
+#include "registro_sd.h"
+#include "compactacion_sd.h"
+#include "perfil.h"
+#include "alarma_critica.h"
 
 RTC_DS3231 rtc;  // Asegúrate de haber inicializado tu RTC en el setup()
 
@@ -63,45 +77,270 @@ WiFiClientSecure client;
 UniversalTelegramBot bot(BOTtoken, client);
 
 //----------FUNCIONES LOGICAS PARA WIFI Y ESP-NOW--------------
-//variables a actualizar 
-float temp = 0;
-float hum = 0;
-int lum = 0;
-float CO2 = 0;
-float valHumsuelo = 0;
+// Las lecturas del sensor se publican con el seqlock de lecturas.h
+
+//----------CONFIGURACION RECARGABLE---------------------------
+// Formato, CRC y valores por defecto en config_blob.h
+
+/// Destino de la configuración, la trama de grupo y la alarma crítica.
+const uint8_t macBroadcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+/// Configuración en uso. Cada decisión copia el puntero una sola vez al empezar.
+const ConfigBlob * volatile cfgActiva = &cfgPorDefecto;
+
+const esp_partition_t *cfgParticion = NULL;
+const uint8_t *cfgMapa = NULL;            // Las dos ranuras mapeadas en memoria
+esp_partition_mmap_handle_t cfgMapaHandle;
+ConfigBlob cfgPendiente;                  // Recibida por el puerto serie, aún sin escribir
+volatile bool cfgHayPendiente = false;
+int64_t cfgUltimaConmutacion = 0;
+
+// Reenvío a los otros nodos
+static const int reenviosConfig = 3;                  // Copias de cada configuración nueva
+static const uint32_t periodoReenvioConfig = 600000;  // ms entre recordatorios de la activa
+volatile int cfgReenvios = 0;
+uint32_t cfgUltimoReenvio = 0;
+
+// Mediciones (microsegundos)
+int64_t cfgTiempoArranque = 0;
+int64_t cfgTiempoEscritura = 0;
+int64_t cfgTiempoConmutacion = 0;
+
+/**
+ * @brief Devuelve la ranura i de la partición mapeada.
+ */
+const ConfigBlob *cfgRanura(int i) {
+  return (const ConfigBlob *) (cfgMapa + i * CFG_TAM_RANURA);
+}
+
+/**
+ * @brief Mapea la partición de configuración y activa la ranura válida más reciente.
+ */
+void cfgIniciar() {
+  int64_t t0 = esp_timer_get_time();
+  cfgParticion = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "invcfg");
+  if (cfgParticion == NULL || cfgParticion->size < 2 * CFG_TAM_RANURA ||
+      esp_partition_mmap(cfgParticion, 0, 2 * CFG_TAM_RANURA, ESP_PARTITION_MMAP_DATA,
+                         (const void **) &cfgMapa, &cfgMapaHandle) != ESP_OK) {
+    cfgMapa = NULL;
+    Serial.println("⚠️ Sin partición de configuración, se usan los valores de compilación");
+  } else {
+    for (int i = 0; i < 2; i++) {
+      const ConfigBlob *c = cfgRanura(i);
+      if (cfgEsValida(c) && c->generacion > cfgActiva->generacion) {
+        cfgActiva = c;
+      }
+    }
+  }
+  cfgTiempoArranque = esp_timer_get_time() - t0;
+  Serial.printf("Configuración generación %u cargada en %lld us\n",
+                (unsigned) cfgActiva->generacion, cfgTiempoArranque);
+}
+
+/**
+ * @brief Acepta una configuración leída del puerto serie si es válida y más nueva.
+ * @return true si el mensaje era una configuración (válida o no).
+ *
+ * Solo copia a RAM; la escritura en flash la hace cfgAplicarPendiente() desde
+ * taskESPNow, que después la reenvía a los otros nodos.
+ */
+bool cfgRecibir(const uint8_t *incomingData, int len) {
+  ConfigBlob nueva;
+  // Llega por el puerto serie: no hay MAC de origen que comprobar
+  switch (cfgEvaluar(incomingData, len, NULL, cfgActiva, &nueva)) {
+    case CFG_NO_ES_CONFIG:
+      return false;
+    case CFG_ORIGEN_DESCONOCIDO:
+      Serial.println("Configuración descartada: no viene del nodo central");
+      break;
+    case CFG_INVALIDA:
+      Serial.println("Configuración descartada: CRC, firma o versión incorrectos");
+      break;
+    case CFG_ANTIGUA:
+      Serial.println("Configuración descartada: generación antigua");
+      break;
+    case CFG_ACEPTADA:
+      if (!cfgHayPendiente) {
+        cfgPendiente = nueva;
+        cfgHayPendiente = true;
+      }
+      break;
+  }
+  return true;
+}
+
+/**
+ * @brief Escribe la configuración pendiente en la ranura inactiva y conmuta.
+ *
+ * La ranura que se borra es la que estaba activa antes de la última
+ * conmutación; CFG_INTERVALO_MIN_MS garantiza que ningún lector la siga usando.
+ */
+void cfgAplicarPendiente() {
+  if (!cfgHayPendiente) {
+    return;
+  }
+  if (cfgMapa == NULL) {
+    Serial.println("❌ No hay partición donde guardar la configuración");
+    cfgHayPendiente = false;
+    return;
+  }
+  if (esp_timer_get_time() - cfgUltimaConmutacion < CFG_INTERVALO_MIN_MS * 1000LL) {
+    return;
+  }
+
+  int destino = (cfgActiva == cfgRanura(0)) ? 1 : 0;
+  size_t offset = destino * CFG_TAM_RANURA;
+  int64_t t0 = esp_timer_get_time();
+  if (esp_partition_erase_range(cfgParticion, offset, CFG_TAM_RANURA) != ESP_OK ||
+      esp_partition_write(cfgParticion, offset, &cfgPendiente, sizeof(ConfigBlob)) != ESP_OK ||
+      !cfgEsValida(cfgRanura(destino))) {
+    Serial.println("❌ Falló la escritura de la configuración");
+    cfgHayPendiente = false;
+    return;
+  }
+  int64_t t1 = esp_timer_get_time();
+  cfgActiva = cfgRanura(destino);
+  int64_t t2 = esp_timer_get_time();
+
+  cfgTiempoEscritura = t1 - t0;
+  cfgTiempoConmutacion = t2 - t1;
+  cfgUltimaConmutacion = t2;
+  cfgHayPendiente = false;
+  cfgReenvios = reenviosConfig;
+  Serial.printf("Configuración generación %u activa (escritura %lld us, conmutación %lld us)\n",
+                (unsigned) cfgActiva->generacion, cfgTiempoEscritura, cfgTiempoConmutacion);
+}
+
+/**
+ * @brief Lee líneas "CFG <hex>" del puerto serie (las que escribe generador_config).
+ *
+ * Es la única entrada de configuraciones del sistema: los otros nodos solo
+ * aceptan las que reenvía el nodo central.
+ */
+void cfgLeerSerie() {
+  static char linea[2 * sizeof(ConfigBlob) + 8];
+  static size_t n = 0;
+  while (Serial.available() > 0) {
+    char ch = Serial.read();
+    if (ch != '\n' && ch != '\r') {
+      if (n + 1 < sizeof(linea)) {
+        linea[n++] = ch;
+      }
+      continue;
+    }
+    linea[n] = '\0';
+    if (strncmp(linea, "CFG ", 4) == 0) {
+      ConfigBlob nueva;
+      if (cfgDesdeHex(linea + 4, &nueva)) {
+        cfgRecibir((const uint8_t *) &nueva, sizeof(nueva));
+      } else {
+        Serial.println("Configuración descartada: hexadecimal incorrecto");
+      }
+    }
+    n = 0;
+  }
+}
+
+/**
+ * @brief Difunde la configuración activa a los nodos de sensores y actuadores.
+ *
+ * El broadcast no tiene ACK: cada configuración nueva se envía reenviosConfig
+ * veces y después se repite cada periodoReenvioConfig para los nodos que
+ * estuvieran apagados. Los nodos descartan las generaciones que ya tienen.
+ */
+void cfgReenviar() {
+  const ConfigBlob *cfg = cfgActiva;
+  if (cfg == &cfgPorDefecto) {
+    return;  // La de compilación no está firmada y todos los nodos la tienen
+  }
+  if (cfgReenvios == 0 && millis() - cfgUltimoReenvio < periodoReenvioConfig) {
+    return;
+  }
+  ConfigBlob copia = *cfg;  // El driver no lee de la flash mapeada
+  if (esp_now_send(macBroadcast, (const uint8_t *) &copia, sizeof(copia)) == ESP_OK) {
+    if (cfgReenvios > 0) {
+      cfgReenvios--;
+    }
+    cfgUltimoReenvio = millis();
+  }
+}
 
 //----------ESP-NOW--------------------------------------------
-uint8_t macSensores[6] = {0xE0, 0x5A, 0x1B, 0x95, 0x25, 0xD4};
-uint8_t macActuadores[6]  = {0x88, 0x13, 0xBF, 0x07, 0xF7, 0xC0}; //88:13:bf:07:f7:c0
-//uint8_t macLum[6]  = {0xC8, 0xF0, 0x9E, 0x7B, 0x78, 0x90};
+
+// Tramas y decisión de actuadores en control.h
 
 //estructura de datos para enviar
 // Estado del envío
 String success;
 
-/**
- * @brief Estructura de datos recibidos desde sensores.
- */
-typedef struct struct_message{
-  float temperatura;
-  float humedad;
-  uint16_t luminosidad;  // entero
-  float vCO2;
-  float humedadSuelo;
-} struct_message;
 struct_message incomingReadings;
+struct_message2 readingsToSend;
+ComandoGrupo comandoGrupo = {TIPO_COMANDO_GRUPO, NUM_ACTUADORES, 0, {0}};
+
+
+//----------CANAL DE ALARMA CRITICA-----------------------------
+// Detección, trama y cota de latencia en alarma_critica.h. Las tramas
+// críticas pendientes salen antes de apagar ESP-NOW.
+
+SemaphoreHandle_t radioMutex = NULL;   // Serializa el apagado/encendido de ESP-NOW con los envíos críticos
+volatile bool espNowActivo = false;
+
+// Mediciones
+uint32_t alarmaEnviadas = 0;
+uint32_t alarmaFallidas = 0;
+int64_t alarmaLatenciaUs = 0;      // Detección a primera copia enviada, último cambio
+int64_t alarmaLatenciaMaxUs = 0;
 
 /**
- * @brief Estructura de datos enviados a los actuadores.
+ * @brief Tarea del canal crítico: envía cada cambio con reintentos y refresca el estado.
  */
-typedef struct struct_message2 {
-  bool eVentilador;
-  bool eBomba;
-  bool eLed;
-  bool eAlarma;
-  bool eCalor;
-} struct_message2;
-struct_message2 readingsToSend;
+void tareaAlarmaCritica(void *parameter) {
+  while (true) {
+    bool cambio = ulTaskNotifyTake(pdTRUE, refrescoAlarma / portTICK_PERIOD_MS) > 0 || alarmaPendiente;
+    if (alarmaCaducar(leerLecturas(), millis())) {
+      cambio = true;
+      Serial.println("Alarma crítica sin luz del sensor en maxEdadLectura: se desactiva");
+    }
+    xSemaphoreTake(radioMutex, portMAX_DELAY);
+    if (espNowActivo) {
+      if (!esp_now_is_peer_exist(macBroadcast)) {
+        esp_now_peer_info_t peer = {};
+        memcpy(peer.peer_addr, macBroadcast, 6);
+        esp_now_add_peer(&peer);
+      }
+      bool pendiente = alarmaPendiente;
+      alarmaPendiente = false;
+      uint8_t bits = alarmaArmarTrama(&comandoCritico);
+      int copias = cambio ? reintentosAlarma : 1;
+      for (int i = 0; i < copias; i++) {
+        if (esp_now_send(macBroadcast, (uint8_t *) &comandoCritico, longitudComandoGrupo(comandoCritico)) == ESP_OK) {
+          alarmaEnviadas++;
+        } else {
+          alarmaFallidas++;
+        }
+        if (i == 0 && pendiente) {
+          alarmaLatenciaUs = esp_timer_get_time() - alarmaDeteccionUs;
+          if (alarmaLatenciaUs > alarmaLatenciaMaxUs) {
+            alarmaLatenciaMaxUs = alarmaLatenciaUs;
+          }
+        }
+        if (i + 1 < copias) {
+          vTaskDelay(separacionReintentos / portTICK_PERIOD_MS);
+        }
+      }
+      xSemaphoreGive(radioMutex);
+      if (pendiente) {
+        Serial.printf("Alarma crítica %s, trama %u: detección a envío %lld us (máx %lld us), enviadas %u, fallidas %u\n",
+                      bits ? "ACTIVA" : "desactivada", (unsigned) comandoCritico.secuencia,
+                      alarmaLatenciaUs, alarmaLatenciaMaxUs,
+                      (unsigned) alarmaEnviadas, (unsigned) alarmaFallidas);
+      }
+    } else {
+      // Sin ESP-NOW no hay a quién avisar; switchToESPNow vuelve a despertar la tarea
+      xSemaphoreGive(radioMutex);
+    }
+  }
+}
 
 esp_now_peer_info_t peerInfo;    // Info del peer para emparejamiento
 
@@ -112,7 +351,7 @@ char macStr[18];  // Para mostrar la MAC como texto
  * @brief Agrega un dispositivo remoto a la red ESP-NOW.
  * @param mac Dirección MAC del peer.
  */
-void addPeer(uint8_t *mac) {
+void addPeer(const uint8_t *mac) {
   memcpy(peerInfo.peer_addr, mac, 6);
   peerInfo.channel = 0;
   peerInfo.encrypt = false;
@@ -134,6 +373,10 @@ void addPeer(uint8_t *mac) {
  * @param len Longitud de los datos.
  */
 void OnDataRecv(const esp_now_recv_info_t *info, const uint8_t *incomingData, int len) {
+  // Las configuraciones solo entran por el puerto serie (cfgLeerSerie)
+  if (len != sizeof(incomingReadings)) {
+    return;
+  }
   memcpy(&incomingReadings, incomingData, sizeof(incomingReadings));
 
   // Imprime la MAC del remitente
@@ -143,170 +386,192 @@ void OnDataRecv(const esp_now_recv_info_t *info, const uint8_t *incomingData, in
            info->src_addr[3], info->src_addr[4], info->src_addr[5]);
   //Serial.println(macStr);
   // Identifica el sensor según la MAC y actualiza variable correspondiente
-  if (memcmp(info->src_addr, macSensores, 6) == 0) {
+  if (memcmp(info->src_addr, cfgActiva->macSensores, 6) == 0) {
+    static uint32_t tramas = 0;
+    // Solo se sustituyen los campos válidos; el resto conserva la última lectura
+    // buena para mostrarla, pero deja de ser usable para decidir
+    Lecturas nuevas = leerLecturas();
+    uint8_t v = incomingReadings.validez;
+    uint32_t ahora = millis();
+    if (v & VALIDO_TEMP)  nuevas.temp = incomingReadings.temperatura;
+    if (v & VALIDO_HUM)   nuevas.hum = incomingReadings.humedad;
+    if (v & VALIDO_LUM)   nuevas.lum = incomingReadings.luminosidad;
+    if (v & VALIDO_CO2)   nuevas.CO2 = incomingReadings.vCO2;
+    if (v & VALIDO_SUELO) nuevas.valHumsuelo = incomingReadings.humedadSuelo;
+    for (int i = 0; i < NUM_CAMPOS; i++) {
+      if (v & (1 << i)) {
+        nuevas.marcaMs[i] = ahora;
+      }
+    }
+    nuevas.validez = v;
+    nuevas.trama = ++tramas;
+    publicarLecturas(nuevas);
+    if (v & VALIDO_LUM) {
+      alarmaEvaluar(cfgActiva, nuevas.lum);
+    }
+
     Serial.print("Temperatura: ");
-    Serial.println(incomingReadings.temperatura);
-    temp = incomingReadings.temperatura;
+    Serial.println(nuevas.temp);
     Serial.print("Humedad: ");
-    Serial.println(incomingReadings.humedad);
-    hum = incomingReadings.humedad;
+    Serial.println(nuevas.hum);
     Serial.print("Luz: ");
-    Serial.println(incomingReadings.luminosidad);
-    lum = incomingReadings.luminosidad;
+    Serial.println(nuevas.lum);
     Serial.print("CO2: ");
-    Serial.println(incomingReadings.vCO2);
-    CO2 = incomingReadings.vCO2;
+    Serial.println(nuevas.CO2);
     Serial.print("Humedad Suelo: ");
-    Serial.println(incomingReadings.humedadSuelo);
-    valHumsuelo = incomingReadings.humedadSuelo;}
+    Serial.println(nuevas.valHumsuelo);}
    //else if (memcmp(info->src_addr, macHum, 6) == 0) {
    //else if (memcmp(info->src_addr, macLum, 6) == 0) {
    else {
     Serial.println("MAC desconocida");
   }}
 
+//----------RELOJ DE SOFTWARE-----------------------------------
+// El RTC se lee por I2C solo al arrancar y cada periodoDisciplina; entre
+// lecturas la hora sale del reloj de software de reloj.h.
+static const int64_t periodoDisciplina = 3600LL * 1000000;  // us entre lecturas del RTC
+static const int64_t toleranciaDisciplina = 1500000;        // us de error antes de corregir
+
+// Mediciones
+uint32_t relojLecturasI2C = 0;    // Llamadas a rtc.now()
+int32_t relojUltimaCorreccion = 0; // ms aplicados en la última disciplina
+
 /**
- * @brief Obtiene la fecha y hora actual del RTC.
- * @return Fecha y hora en formato "dd/mm/yyyy hh:mm:ss".
+ * @brief Sincroniza el reloj con el RTC esperando al cambio de segundo.
+ *
+ * Se usa al arrancar: leer en el flanco da la fase con precisión de unos
+ * pocos milisegundos en lugar del segundo completo.
  */
-String obtenerFechaHora() {
-  DateTime now = rtc.now();
-  char fechaHora[25];
-  snprintf(fechaHora, sizeof(fechaHora), "%02d/%02d/%04d %02d:%02d:%02d",
-           now.day(), now.month(), now.year(),
-           now.hour(), now.minute(), now.second());
-  return String(fechaHora);
+void relojIniciar() {
+  DateTime r0 = rtc.now();
+  DateTime r = r0;
+  relojLecturasI2C++;
+  int64_t limite = esp_timer_get_time() + 1100000;
+  while (r.second() == r0.second() && esp_timer_get_time() < limite) {
+    delay(1);
+    r = rtc.now();
+    relojLecturasI2C++;
+  }
+  relojSincronizar((int64_t) r.unixtime() * 1000000, esp_timer_get_time());
 }
 
 /**
- * @brief Formatea la lectura de sensores en formato JSON.
- * @param temperaturaf Temperatura.
- * @param humedadf Humedad relativa.
- * @param luminosidadf Luminosidad.
- * @param CO2f Concentración de CO2.
- * @param humedadSuelof Humedad del suelo.
- * @return Lectura formateada en JSON.
+ * @brief Corrige el reloj con una lectura del RTC si toca (cada periodoDisciplina).
+ *
+ * La lectura solo dice en qué segundo estamos, así que se corrige únicamente
+ * cuando el error supera toleranciaDisciplina, llevando el reloj a la mitad
+ * de ese segundo.
  */
-String formatearLecturaSensores(float temperaturaf, float humedadf, uint16_t luminosidadf, float CO2f, float humedadSuelof) {
-  String fecha_hora = obtenerFechaHora();
-
-  char buffer[256];
-  snprintf(buffer, sizeof(buffer),
-           "{ \"fecha_hora\": \"%s\", \"temperatura\": %.2f, \"humedad\": %.2f, \"luminosidad\": %u, \"CO2\": %.2f, \"humedad_suelo\": %.2f }",
-           fecha_hora.c_str(), temperaturaf, humedadf, luminosidadf, CO2f, humedadSuelof);
+void relojDisciplinar() {
+  if (esp_timer_get_time() - relojUltimaDisciplina < periodoDisciplina) {
+    return;
+  }
+  DateTime r = rtc.now();
+  int64_t t = esp_timer_get_time();
+  relojLecturasI2C++;
+
+  int64_t rtcUs = (int64_t) r.unixtime() * 1000000 + 500000;
+  portENTER_CRITICAL(&relojMux);
+  int64_t error = rtcUs - (relojBaseUs + (t - relojTBase));
+  if (error > toleranciaDisciplina || error < -toleranciaDisciplina) {
+    relojBaseUs = rtcUs;
+    relojTBase = t;
+    relojUltimaCorreccion = error / 1000;
+  } else {
+    relojUltimaCorreccion = 0;
+  }
+  relojUltimaDisciplina = t;
+  portEXIT_CRITICAL(&relojMux);
 
-  return String(buffer);
+  Serial.printf("Reloj: %u lecturas I2C en %u consultas, formateo medio %u ciclos, corrección %d ms\n",
+                (unsigned) relojLecturasI2C, (unsigned) relojConsultas,
+                (unsigned) (relojFormateos ? relojCiclosFormateo / relojFormateos : 0),
+                (int) relojUltimaCorreccion);
 }
 
 /**
  * @brief Guarda la lectura actual formateada en memoria (SD o futura implementación).
  */
 void guardarEnMemoria(){
-  String lectura = formatearLecturaSensores(temp, hum, lum, CO2, valHumsuelo); 
+  char fechaHora[25];
+  char lectura[256];
+  Lecturas l = leerLecturas();
+  obtenerFechaHora(fechaHora, sizeof(fechaHora));
+  formatearLecturaSensores(lectura, sizeof(lectura), fechaHora, l.temp, l.hum, l.lum, l.CO2, l.valHumsuelo);
 }
 
-/**
- * @brief Evalúa condiciones para activar actuadores y actualiza la estructura de envío.
- */
-void variablesEnvio(){
-  Serial.println("condicones para enviar");
-  if (temp > 28 || hum > 60 || CO2 > 1800) {
-    readingsToSend.eVentilador = true;
-  } else {readingsToSend.eVentilador = false;}
-  if (temp < 18){
-    readingsToSend.eCalor = true;
-  }else {readingsToSend.eCalor = false;}
-  if (lum > 3500){
-    readingsToSend.eAlarma = true;
-  } else {readingsToSend.eAlarma = false;}
-  if (lum < 2500){
-    readingsToSend.eLed = true;
-  } else {readingsToSend.eLed = false;}
-  if (valHumsuelo < 60){
-    readingsToSend.eBomba = true;
-  } else {readingsToSend.eBomba = false;}
-}
-// Callback de envío
 
 /**
  * @brief Callback al enviar datos a través de ESP-NOW.
- * @param macActuadores Dirección MAC del destinatario.
+ * @param mac Dirección MAC del destinatario.
  * @param status Estado del envío.
  */
-void OnDataSent(const uint8_t *macActuadores, esp_now_send_status_t status) {
+void OnDataSent(const uint8_t *mac, esp_now_send_status_t status) {
   Serial.println("enviooooooooooo");
   Serial.print("\r\nEstado del envío:\t");
   Serial.println(status == ESP_NOW_SEND_SUCCESS ? "Éxito" : "Fallo");
   success = (status == ESP_NOW_SEND_SUCCESS) ? "Éxito :)" : "Fallo :(";
 }
+
 //------------FUNCIONES DE TELEGRAM---------------------------
 // --- Generación de alarma cuando se superan límites ---
+// Un aviso al superarse los límites y, mientras sigan superados, uno cada
+// periodoTelegram. Cada aviso abre una ventana WiFi sin ESP-NOW (ver
+// alarma_critica.h), así que un intento fallido no se repite antes de
+// reintentoTelegram.
+static const uint32_t periodoTelegram = 600000;   // ms entre avisos con los límites superados
+static const uint32_t reintentoTelegram = 60000;  // ms entre intentos de aviso
+
+bool telegramAvisado = false;     // Límites superados y ya avisados
+uint32_t telegramMarca = 0;       // millis() del último aviso
+bool telegramIntentado = false;
+uint32_t telegramIntento = 0;     // millis() del último intento
+
+/**
+ * @brief Indica si toca abrir la ventana WiFi para avisar por Telegram.
+ */
+bool telegramToca() {
+  if (!limitesSuperados(cfgActiva, leerLecturas(), millis())) {
+    telegramAvisado = false;
+    return false;
+  }
+  uint32_t ahora = millis();
+  if (telegramIntentado && ahora - telegramIntento < reintentoTelegram) {
+    return false;
+  }
+  return !telegramAvisado || ahora - telegramMarca >= periodoTelegram;
+}
+
 /**
  * @brief Envía alerta a Telegram si se superan límites de variables.
+ * @return true si Telegram aceptó el mensaje.
  */
-void generacionAlarma() {
+bool generacionAlarma() {
   Serial.println("inicio");
-   if (temp > 28||temp < 18 || hum > 60 || lum > 3500||lum < 2500 || CO2 >= 1800 || valHumsuelo < 60) {
+  Lecturas l = leerLecturas();
+  uint32_t ahora = millis();
+  bool enviado = false;
+   if (limitesSuperados(cfgActiva, l, ahora)) {
     Serial.println("inicio condicional");
-    //DateTime now = rtc.now();  // Obtiene fecha y hora actual
-    //Serial.println("despues de rtc");
-
-    //char fechaHora[25];
-    //snprintf(fechaHora, sizeof(fechaHora), "%02d/%02d/%04d %02d:%02d:%02d",
-      //       now.day(), now.month(), now.year(),
-        //     now.hour(), now.minute(), now.second());
 
     char msg[520];  // Asegúrate de que el tamaño sea suficiente
-    snprintf(msg, sizeof(msg),
-             "‼️ ¡¡LÍMITE DE VARIABLES SUPERADO!!\n"
-             "#INVERNADERO\n"
-             //"🕒 Fecha y hora: %s\n"
-             "🌡 Temp: %.2f °C\n"
-             "💧 Humedad: %.2f %%\n"
-             "☀️ Luz: %u\n"
-             "🌫 CO₂: %.2f PPM\n"
-             "#FIN",
-         temp, hum, lum, CO2);
+    formatearMensajeAlarma(msg, sizeof(msg), l, lecturasUsables(l, ahora));
 
     Serial.println("despues del formateo de datos");
     Serial.println(msg);
-    bot.sendMessage(CHAT_ID, msg, "");
+    enviado = bot.sendMessage(CHAT_ID, msg, "");
     Serial.println("despues de enviar el mensaje a telegram");
   }
+  telegramIntentado = true;
+  telegramIntento = millis();
+  if (enviado) {
+    telegramAvisado = true;
+    telegramMarca = telegramIntento;
+  }
+  return enviado;
 }
 
-// Funciones para guardar datos en la memoria SD
-// RTC
-RTC_DS3231 rtc;
-
-// Estructura de datos del sensor a guardar
-/**
- * @struct SensorData
- * @brief Estructura de datos que se podrían guardar en la tarjeta SD.
- */
-struct SensorData {
-  float Stemperatura;
-  float Shumedad;
-  uint16_t Sluminosidad;
-  float SvCO2;
-  float ShumedadSuelo;
-};
-
-// Pines SPI (ajusta si usas otros)
-#define SD_CS 5
-
-/**
- * @brief Inicializa la tarjeta SD.
- * @return true si tuvo éxito, false en caso contrario.
- */
-bool initSD() {
-    if (!SD.begin(SD_CS)) {
-        Serial.println("❌ Falló la inicialización de la tarjeta SD");
-        return false;
-    }
-    Serial.println("✅ Tarjeta SD inicializada correctamente");
-    return true;
-}
+// Funciones para guardar datos en la memoria SD: registro_sd.h
 
 /**
  * @brief Inicializa el reloj RTC.
@@ -324,75 +589,29 @@ bool initRTC() {
     return true;
 }
 
-String getTimestampFromRTC() {
-    DateTime now = rtc.now();
-    char buf[20];
-    snprintf(buf, sizeof(buf), "%04d-%02d-%02d %02d:%02d:%02d",
-             now.year(), now.month(), now.day(),
-             now.hour(), now.minute(), now.second());
-    return String(buf);
-}
-
-String getFolderPath(const String& timestamp) {
-    String date = timestamp.substring(0, 10);    // YYYY-MM-DD
-    String hour = timestamp.substring(11, 13);   // HH
-    return "/" + date + "/" + hour;
-}
-
-String getFilePath(const String& timestamp) {
-    return getFolderPath(timestamp) + "/data.csv";
-}
+//----------COMPACTACION SD-----------------------------------
+// Compactación y retención de los CSV por hora: compactacion_sd.h
+static const uint32_t retrasoCompactacion = 60000;  // ms tras el arranque antes de la primera pasada
 
-void ensureDirectoriesExist(const String& folderPath) {
-    String current = "";
-    for (int i = 1; i < folderPath.length(); ++i) {
-        if (folderPath[i] == '/') {
-            current = folderPath.substring(0, i);
-            if (!SD.exists(current)) {
-                SD.mkdir(current);
-            }
+/**
+ * @brief Tarea de compactación: una pasada al cambiar de hora.
+ *
+ * Va en app_cpu con la prioridad de loopTask y por debajo de las tareas de
+ * comunicación.
+ */
+void tareaCompactador(void *parameter) {
+    vTaskDelay(retrasoCompactacion / portTICK_PERIOD_MS);
+    uint32_t ultimaHora = UINT32_MAX;
+    while (true) {
+        uint32_t hora = relojEpoch() / 3600;
+        if (hora != ultimaHora) {
+            ultimaHora = hora;
+            compactarSD();
         }
-    }
-    if (!SD.exists(folderPath)) {
-        SD.mkdir(folderPath);
+        vTaskDelay(60000 / portTICK_PERIOD_MS);
     }
 }
 
-bool logSensorData(const String& timestamp, const SensorData& data) {
-    String folderPath = getFolderPath(timestamp);
-    String filePath = getFilePath(timestamp);
-
-    ensureDirectoriesExist(folderPath);
-
-    File file = SD.open(filePath, FILE_APPEND);
-    if (!file) {
-        Serial.println("❌ No se pudo abrir el archivo para escritura.");
-        return false;
-    }
-
-    // Escribir encabezado si el archivo está vacío
-    if (file.size() == 0) {
-        file.println("timestamp,nodeId,rssi,temp,hum,light,co2ppm,soilMoisture");
-    }
-
-    // Construcción de la línea CSV
-    String csvLine = timestamp + "," + nodeId + "," + String(rssi) + "," +
-                     String(data.Stemperatura, 2) + "," +
-                     String(data.Shumedad, 2) + "," +
-                     String(data.Sluminosidad) + "," +
-                     String(data.SvCO2, 2) + "," +
-                     String(data.ShumedadSuelo, 2);
-
-    if (file.println(csvLine) == 0) {
-        Serial.println("❌ Error al escribir en el archivo.");
-        file.close();
-        return false;
-    }
-
-    file.close();
-    return true;
-}
-
 //----------------Tareas para conmutar entre esp now y wifi
 // Bandera para controlar el modo actual de la conmutacion
 volatile bool useWiFi = false;
@@ -400,7 +619,6 @@ volatile bool adicion_peers = false;
 
 // variables de tiempo
 static const int espera_conexion_wifi = 200;
-static const int limpiar_hardware = 200;
 static const int tiempo_taskESPNow = 1000;
 static const int tiempo_envio_datos = 200;
 static const int tiempo_taskWiFi = 1000;
@@ -409,19 +627,111 @@ static const int tiempo_taskWiFi = 1000;
 TaskHandle_t ESPNowTask = NULL;
 TaskHandle_t WiFiTask = NULL;
 
+// Mediciones de la ventana WiFi (ESP-NOW apagado)
+int64_t ventanaWiFiInicio = 0;
+int64_t ventanaWiFiUs = 0;
+int64_t ventanaWiFiMaxUs = 0;
+uint32_t ventanasWiFi = 0;
+uint32_t conexionesFallidas = 0;
+uint32_t dnsFallidos = 0;
+
+// Resolución DNS acotada de la ventana WiFi (resolverTelegram)
+volatile bool dnsEnCurso = false;
+volatile bool dnsResuelto = false;
+
+//----------PERFILADOR DE TAREAS--------------------------------
+// Cada tarea periódica marca su ciclo y su trabajo (perfil.h); la tarea
+// Perfilador reporta cada periodoPerfilador la ocupación, la pila libre mínima
+// y el periodo real frente al nominal.
+
+// Periodo nominal de taskESPNow: espera de datos + espera antes de WiFi + tiempo_taskESPNow
+PerfilTarea perfilESPNow = perfilNuevo("ESPNowTask", 4096, 200 + 500 + tiempo_taskESPNow);
+PerfilTarea perfilWiFi = perfilNuevo("WiFiTask", 8192, tiempo_taskWiFi);
+PerfilTarea *perfiles[] = {&perfilESPNow, &perfilWiFi};
+
+/**
+ * @brief Tarea de baja prioridad que emite el reporte periódico de tareas.
+ */
+void tareaPerfilador(void *parameter) {
+  while (true) {
+    vTaskDelay(periodoPerfilador / portTICK_PERIOD_MS);
+    Serial.printf("PERFIL t=%lu s, reintentos de lectura %u, ocupación %s\n",
+                  (unsigned long) (millis() / 1000), (unsigned) lecturasReintentos.load(),
+                  PERFIL_CPU_FREERTOS ? "con estadísticas de FreeRTOS" : "por marcas (tiempo de pared)");
+#if PERFIL_CPU_FREERTOS
+    perfilReportarCPU();
+#endif
+    for (size_t i = 0; i < sizeof(perfiles) / sizeof(perfiles[0]); i++) {
+      perfilReportarPeriodo(perfiles[i]);
+    }
+  }
+}
 
-void switchToWiFi() {
-  if(temp > 28||temp < 18 || hum > 60 || lum > 3500||lum < 2500 || CO2 >= 1800 || valHumsuelo < 60){
+
+/**
+ * @brief Apaga ESP-NOW y se conecta al punto de acceso, como mucho conexionWiFiMax.
+ *
+ * Sin conexión taskWiFi vuelve a ESP-NOW sin avisar.
+ * @return false si la alarma se activó mientras tanto y ESP-NOW sigue encendido.
+ */
+bool switchToWiFi() {
+  // Las tramas críticas pendientes salen antes de apagar ESP-NOW
+  xSemaphoreTake(radioMutex, portMAX_DELAY);
+  while (alarmaPendiente) {
+    xSemaphoreGive(radioMutex);
+    vTaskDelay(1);
+    xSemaphoreTake(radioMutex, portMAX_DELAY);
+  }
+  if (!ventanaWiFiPermitida()) {
+    xSemaphoreGive(radioMutex);
+    return false;
+  }
+  espNowActivo = false;
   esp_now_deinit();
+  xSemaphoreGive(radioMutex);
+  ventanaWiFiInicio = esp_timer_get_time();
   WiFi.disconnect(true);
   adicion_peers = false;
   vTaskDelay(limpiar_hardware/portTICK_PERIOD_MS);
   WiFi.begin(ssid, password);
-  while (WiFi.status() != WL_CONNECTED) {
+  uint32_t t0 = millis();
+  while (WiFi.status() != WL_CONNECTED && millis() - t0 < (uint32_t) conexionWiFiMax) {
    Serial.println("conectando...");
    vTaskDelay(espera_conexion_wifi/portTICK_PERIOD_MS);
-  }}
-  else{useWiFi = false;}
+  }
+  return true;
+}
+
+/**
+ * @brief Resuelve api.telegram.org y avisa a taskWiFi (ver resolverTelegram).
+ */
+void tareaDNS(void *parameter) {
+  IPAddress ip;
+  dnsResuelto = WiFi.hostByName(TELEGRAM_HOST, ip) == 1;
+  dnsEnCurso = false;
+  xTaskNotifyGive(WiFiTask);
+  vTaskDelete(NULL);
+}
+
+/**
+ * @brief Resuelve la dirección de Telegram esperando como mucho dnsTelegramMax.
+ *
+ * La espera de hostByName la fija el core, no el sketch: la consulta va en
+ * tareaDNS y, si responde a tiempo, bot.sendMessage encuentra la dirección en
+ * la caché DNS de lwIP. Una consulta que no vuelve se abandona (acaba sola) y
+ * la ventana se cierra sin avisar.
+ * @return true si se resolvió a tiempo.
+ */
+bool resolverTelegram() {
+  if (dnsEnCurso) {
+    return false;  // La consulta de una ventana anterior sigue sin volver
+  }
+  dnsEnCurso = true;
+  dnsResuelto = false;
+  ulTaskNotifyTake(pdTRUE, 0);
+  xTaskCreatePinnedToCore(tareaDNS, "DNS", 3072, NULL, 1, NULL, 0);
+  ulTaskNotifyTake(pdTRUE, dnsTelegramMax / portTICK_PERIOD_MS);
+  return !dnsEnCurso && dnsResuelto;
 }
 
 void switchToESPNow() {
@@ -431,44 +741,75 @@ void switchToESPNow() {
   if (esp_now_init() != ESP_OK) {
     Serial.println("Error inicializando ESP-NOW");
   }
-  else{Serial.println("inicio correctamente");}
+  else{
+    Serial.println("inicio correctamente");
+    // esp_now_deinit borró los callbacks: sin esperar al ciclo de taskESPNow
+    esp_now_register_recv_cb(OnDataRecv);
+    esp_now_register_send_cb(OnDataSent);
+    xSemaphoreTake(radioMutex, portMAX_DELAY);
+    espNowActivo = true;
+    xSemaphoreGive(radioMutex);
+    // Reafirmar el estado de la alarma tras el hueco de radio
+    xTaskNotifyGive(AlarmaCriticaTask);
+  }
+  ventanaWiFiUs = esp_timer_get_time() - ventanaWiFiInicio;
+  if (ventanaWiFiUs > ventanaWiFiMaxUs) {
+    ventanaWiFiMaxUs = ventanaWiFiUs;
+  }
+  ventanasWiFi++;
+  Serial.printf("Ventana WiFi %u: %lld us (máx %lld us, límite %d ms), conexiones fallidas %u, DNS fallidos %u\n",
+                (unsigned) ventanasWiFi, ventanaWiFiUs, ventanaWiFiMaxUs, ventanaWiFiMax,
+                (unsigned) conexionesFallidas, (unsigned) dnsFallidos);
 }
  
 // Tarea para manejar ESP-NOW
 void taskESPNow(void *parameter) {
   while (1) {
+    perfilMarcar(&perfilESPNow);
     if (!useWiFi) {
       // Ejecutar tareas ESP-NOW
       //esp_now_register_recv_cb(OnDataRecv);
       vTaskDelay(200 / portTICK_PERIOD_MS);  // Espera datos
+      perfilInicioTrabajo(&perfilESPNow);
+      cfgAplicarPendiente();
+      relojDisciplinar();
       
+      // Los peers se pierden con esp_now_deinit: se agregan tras cada ventana WiFi
       if (adicion_peers == false){
-      addPeer(macSensores);
-      addPeer(macActuadores);
+      const ConfigBlob *cfg = cfgActiva;
+      addPeer(cfg->macSensores);
+      addPeer(macBroadcast);
       //addPeer(macLum);
       esp_now_register_recv_cb(OnDataRecv);
+      esp_now_register_send_cb(OnDataSent);
+      adicion_peers = true;
+      }
 
       //guaradar variables medidas en memorias cada 1 seg en subcarpetas por hora, subcarpetas generadas por dia
-      SensorData data = {temp, hum, lum, CO2, valHumsuelo};
-      String timestamp = getTimestampFromRTC();
-      logSensorData(timestamp, "NODE1", -60, data, 1);
-      variablesEnvio();
+      Lecturas l = leerLecturas();
+      SensorData data = {l.temp, l.hum, (uint16_t) l.lum, l.CO2, l.valHumsuelo};
+      char timestamp[20];
+      getTimestampFromRTC(timestamp, sizeof(timestamp));
+      logSensorData(timestamp, "NODE1", -60, data);
+      Serial.println("condicones para enviar");
+      readingsToSend = variablesEnvio(cfgActiva, l, millis(), &comandoGrupo);
       Serial.println("despues de funcion envio");
-      esp_now_register_send_cb(OnDataSent);
       //Enviar datos
-      esp_err_t result = esp_now_send(macActuadores, (uint8_t *) &readingsToSend, sizeof(readingsToSend));
+      esp_err_t result = esp_now_send(macBroadcast, (uint8_t *) &comandoGrupo, longitudComandoGrupo(comandoGrupo));
       if (result == ESP_OK) {
         Serial.println("Datos enviados exitosamente");
       } else {
         Serial.println("Error al enviar los datos");
       }
-      adicion_peers = true;
-      }
+      cfgReenviar();
+      perfilFinTrabajo(&perfilESPNow);
     
       vTaskDelay(500 / portTICK_PERIOD_MS);
-      // Cambiar a WiFi
-      useWiFi = true;
-      switchToWiFi();
+      // Cambiar a WiFi solo para avisar por Telegram y nunca con la alarma activa
+      if (ventanaWiFiPermitida() && telegramToca() && switchToWiFi()) {
+        useWiFi = true;
+        xTaskNotifyGive(WiFiTask);
+      }
     }
     vTaskDelay(tiempo_taskESPNow / portTICK_PERIOD_MS);
   }
@@ -477,24 +818,32 @@ void taskESPNow(void *parameter) {
 // Tarea para manejar WiFi
 void taskWiFi(void *parameter) {
   while (1) {
+    perfilMarcar(&perfilWiFi);
      if(useWiFi == true){
+       perfilInicioTrabajo(&perfilWiFi);
+       // switchToWiFi ya esperó conexionWiFiMax: sin conexión no se insiste
        if (WiFi.status() != WL_CONNECTED) {
-       Serial.println("conectando...");
-       switchToWiFi();
-       }
-       else
-       {Serial.println("conectado");}
-
-       while (WiFi.status() != WL_CONNECTED){
-        Serial.println("conectando...");
+         conexionesFallidas++;
+         telegramIntentado = true;
+         telegramIntento = millis();
+         Serial.println("Sin conexión WiFi, se vuelve a ESP-NOW");
+       } else if (!resolverTelegram()) {
+         dnsFallidos++;
+         telegramIntentado = true;
+         telegramIntento = millis();
+         Serial.println("Sin DNS en dnsTelegramMax, se vuelve a ESP-NOW");
+       } else {
+         Serial.println("conectado");
+         generacionAlarma();
        }
-      generacionAlarma();
 
-      // Cambiar a ESP-NOW
-      useWiFi = false;
+      // Cambiar a ESP-NOW antes de devolver el turno a taskESPNow
       switchToESPNow();
+      useWiFi = false;
+      perfilFinTrabajo(&perfilWiFi);
     }
-    vTaskDelay(tiempo_taskWiFi/ portTICK_PERIOD_MS);
+    // taskESPNow la despierta al abrir la ventana
+    ulTaskNotifyTake(pdTRUE, tiempo_taskWiFi / portTICK_PERIOD_MS);
   }
 }
 
@@ -504,13 +853,17 @@ void setup() {
    Wire.begin();
 
     initRTC();
-    initSD();
+    relojIniciar();
+    bool sdLista = initSD();
+    cfgIniciar();
   WiFi.mode(WIFI_STA);
   esp_now_init();
   // Inicializa ESP-NOW
     if (esp_now_init() != ESP_OK) {
     Serial.println("Error inicializando ESP-NOW");
     return;}
+  espNowActivo = true;
+  radioMutex = xSemaphoreCreateMutex();
  
   // Configuración del cliente seguro según ESP8266 o ESP32
   #ifdef ESP8266
@@ -519,12 +872,26 @@ void setup() {
   #endif
   #ifdef ESP32
     client.setCACert(TELEGRAM_CERTIFICATE_ROOT);
+    // Límites de la ventana WiFi (alarma_critica.h); setTimeout en ms en el core 3.x
+    client.setTimeout(tcpTelegramMax);
+    client.setHandshakeTimeout(tlsTelegramMax / 1000);
   #endif
-
-  xTaskCreatePinnedToCore(taskESPNow, "ESPNowTask", 4096, NULL, 1, NULL, 0);
-  xTaskCreatePinnedToCore(taskWiFi, "WiFiTask", 8192, NULL, 1, NULL, 0);
+  bot.waitForResponse = respuestaTelegramMax;
+
+  // Por encima de las tareas de comunicación, en el mismo núcleo
+  xTaskCreatePinnedToCore(tareaAlarmaCritica, "AlarmaCritica", 3072, NULL, 3, &AlarmaCriticaTask, 0);
+  xTaskCreatePinnedToCore(taskESPNow, "ESPNowTask", perfilESPNow.pila, NULL, 1, &ESPNowTask, 0);
+  xTaskCreatePinnedToCore(taskWiFi, "WiFiTask", perfilWiFi.pila, NULL, 1, &WiFiTask, 0);
+  perfilESPNow.tarea = ESPNowTask;
+  perfilWiFi.tarea = WiFiTask;
+  xTaskCreatePinnedToCore(tareaPerfilador, "Perfilador", 3072, NULL, 1, NULL, app_cpu);
+  if (sdLista) {
+    xTaskCreatePinnedToCore(tareaCompactador, "Compactador", 6144, NULL, tskIDLE_PRIORITY + 1, NULL, app_cpu);
+  }
 }
 
 void loop() {
+  cfgLeerSerie();
+  vTaskDelay(50 / portTICK_PERIOD_MS);
 }   
 
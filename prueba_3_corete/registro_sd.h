@@ -0,0 +1,167 @@
+/**
+ * @file registro_sd.h
+ * @brief Registro de lecturas en la tarjeta SD, un CSV por hora.
+ *
+ * El árbol es /YYYY-MM-DD/HH/data.csv. sdMutex serializa el acceso entre
+ * logSensorData y la compactación.
+ */
+#ifndef CENTRAL_REGISTRO_SD_H
+#define CENTRAL_REGISTRO_SD_H
+
+#include <Arduino.h>
+#include <SD.h>
+
+// Estructura de datos del sensor a guardar
+/**
+ * @struct SensorData
+ * @brief Estructura de datos que se podrían guardar en la tarjeta SD.
+ */
+struct SensorData {
+  float Stemperatura;
+  float Shumedad;
+  uint16_t Sluminosidad;
+  float SvCO2;
+  float ShumedadSuelo;
+};
+
+// Pines SPI (ajusta si usas otros)
+#define SD_CS 5
+
+// Serializa el acceso a la SD entre logSensorData y la compactación
+inline SemaphoreHandle_t sdMutex = NULL;
+
+/**
+ * @brief Tiempos y volumen de uso de la SD; se reinician en cada informe de compactación.
+ */
+typedef struct UsoSD {
+  uint32_t registroMaxUs;   ///< logSensorData completo, espera incluida
+  uint32_t esperaMaxUs;     ///< Espera de logSensorData por sdMutex
+  uint32_t tramoMaxUs;      ///< Retención más larga de sdMutex por la compactación
+  uint32_t tramos;
+  uint64_t retenidoUs;      ///< Suma de retención de sdMutex por la compactación
+  uint32_t bytesLeidos;
+  uint32_t bytesEscritos;
+} UsoSD;
+
+inline UsoSD usoSD;
+
+/**
+ * @brief Inicializa la tarjeta SD.
+ * @return true si tuvo éxito, false en caso contrario.
+ */
+inline bool initSD() {
+    sdMutex = xSemaphoreCreateMutex();
+    if (!SD.begin(SD_CS)) {
+        Serial.println("❌ Falló la inicialización de la tarjeta SD");
+        return false;
+    }
+    Serial.println("✅ Tarjeta SD inicializada correctamente");
+    return true;
+}
+
+/**
+ * @brief Carpeta de un timestamp: "/YYYY-MM-DD/HH".
+ */
+inline void getFolderPath(const char *timestamp, char *buf, size_t n) {
+    snprintf(buf, n, "/%.10s/%.2s", timestamp, timestamp + 11);
+}
+
+/**
+ * @brief Archivo de un timestamp: "/YYYY-MM-DD/HH/data.csv".
+ */
+inline void getFilePath(const char *timestamp, char *buf, size_t n) {
+    snprintf(buf, n, "/%.10s/%.2s/data.csv", timestamp, timestamp + 11);
+}
+
+/**
+ * @brief Crea cada nivel de folderPath que no exista.
+ */
+inline void ensureDirectoriesExist(const char *folderPath) {
+    char current[32];
+    size_t len = strlen(folderPath);
+    for (size_t i = 1; i < len && i < sizeof(current); ++i) {
+        if (folderPath[i] == '/') {
+            memcpy(current, folderPath, i);
+            current[i] = '\0';
+            if (!SD.exists(current)) {
+                SD.mkdir(current);
+            }
+        }
+    }
+    if (!SD.exists(folderPath)) {
+        SD.mkdir(folderPath);
+    }
+}
+
+/**
+ * @brief Formatea una línea del CSV (sin salto de línea).
+ * @return Longitud del texto (como snprintf).
+ */
+inline int formatearLineaCSV(char *buf, size_t n, const char *timestamp, const char *nodeId, int rssi,
+                             const SensorData &data) {
+    return snprintf(buf, n, "%s,%s,%d,%.2f,%.2f,%u,%.2f,%.2f",
+                    timestamp, nodeId, rssi,
+                    data.Stemperatura, data.Shumedad, data.Sluminosidad,
+                    data.SvCO2, data.ShumedadSuelo);
+}
+
+/**
+ * @brief Escribe la línea en el CSV de su hora; llamar con sdMutex tomado.
+ */
+inline bool escribirRegistro(const char *timestamp, const char *nodeId, int rssi, const SensorData &data) {
+    char folderPath[20];
+    char filePath[32];
+    getFolderPath(timestamp, folderPath, sizeof(folderPath));
+    getFilePath(timestamp, filePath, sizeof(filePath));
+
+    ensureDirectoriesExist(folderPath);
+
+    File file = SD.open(filePath, FILE_APPEND);
+    if (!file) {
+        Serial.println("❌ No se pudo abrir el archivo para escritura.");
+        return false;
+    }
+
+    // Escribir encabezado si el archivo está vacío
+    if (file.size() == 0) {
+        file.println("timestamp,nodeId,rssi,temp,hum,light,co2ppm,soilMoisture");
+    }
+
+    // Construcción de la línea CSV
+    char csvLine[96];
+    formatearLineaCSV(csvLine, sizeof(csvLine), timestamp, nodeId, rssi, data);
+
+    if (file.println(csvLine) == 0) {
+        Serial.println("❌ Error al escribir en el archivo.");
+        file.close();
+        return false;
+    }
+
+    file.close();
+    return true;
+}
+
+/**
+ * @brief Agrega una lectura al CSV de la hora correspondiente al timestamp.
+ *
+ * Mide su duración y la espera por sdMutex, para comprobar que la
+ * compactación no retrasa el registro.
+ * @return true si se escribió la línea.
+ */
+inline bool logSensorData(const char *timestamp, const char *nodeId, int rssi, const SensorData &data) {
+    uint32_t t0 = micros();
+    xSemaphoreTake(sdMutex, portMAX_DELAY);
+    uint32_t espera = micros() - t0;
+    bool ok = escribirRegistro(timestamp, nodeId, rssi, data);
+    xSemaphoreGive(sdMutex);
+    uint32_t total = micros() - t0;
+    if (espera > usoSD.esperaMaxUs) {
+        usoSD.esperaMaxUs = espera;
+    }
+    if (total > usoSD.registroMaxUs) {
+        usoSD.registroMaxUs = total;
+    }
+    return ok;
+}
+
+#endif
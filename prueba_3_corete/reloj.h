@@ -0,0 +1,206 @@
+/**
+ * @file reloj.h
+ * @brief Reloj de software del nodo central y formateo de fechas.
+ *
+ * Entre lecturas del RTC (relojIniciar y relojDisciplinar, en el sketch) la
+ * hora sale de esp_timer. Las dos cadenas de fecha se guardan ya formateadas
+ * y al pasar de segundo solo se reescriben los dígitos de la hora. Las fechas
+ * se calculan desde el tiempo unix sin DateTime, con aritmética de días civiles.
+ */
+#ifndef CENTRAL_RELOJ_H
+#define CENTRAL_RELOJ_H
+
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "esp_cpu.h"
+
+inline portMUX_TYPE relojMux = portMUX_INITIALIZER_UNLOCKED;
+inline int64_t relojBaseUs = 0;          // Tiempo unix (us) en el instante relojTBase
+inline int64_t relojTBase = 0;           // esp_timer_get_time() de la última sincronización
+inline int64_t relojUltimaDisciplina = 0;
+inline int64_t relojUltimoUs = 0;        // Último valor entregado (para ser monótono)
+inline uint32_t relojCacheEpoch = 0;     // Segundo al que corresponden las cadenas
+inline char relojTimestamp[20] = "2000-01-01 00:00:00";   // "YYYY-MM-DD hh:mm:ss"
+inline char relojFechaHora[20] = "01/01/2000 00:00:00";   // "dd/mm/yyyy hh:mm:ss"
+
+// Mediciones
+inline uint32_t relojConsultas = 0;      // Fechas entregadas
+inline uint32_t relojFormateos = 0;      // Actualizaciones de las cadenas
+inline uint64_t relojCiclosFormateo = 0; // Ciclos de CPU gastados en esas actualizaciones
+
+/**
+ * @brief Días desde 1970-01-01 de una fecha del calendario gregoriano.
+ */
+inline int32_t diasDesdeCivil(int anio, int mes, int dia) {
+  anio -= mes <= 2;
+  int32_t era = (anio >= 0 ? anio : anio - 399) / 400;
+  uint32_t yoe = anio - era * 400;
+  uint32_t doy = (153 * (mes + (mes > 2 ? -3 : 9)) + 2) / 5 + dia - 1;
+  uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int32_t) doe - 719468;
+}
+
+/**
+ * @brief Fecha del calendario gregoriano de un número de días desde 1970-01-01.
+ */
+inline void civilDesdeDias(int32_t dias, int *anio, int *mes, int *dia) {
+  dias += 719468;
+  int32_t era = (dias >= 0 ? dias : dias - 146096) / 146097;
+  uint32_t doe = dias - era * 146097;
+  uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  uint32_t mp = (5 * doy + 2) / 153;
+  *dia = doy - (153 * mp + 2) / 5 + 1;
+  *mes = mp < 10 ? mp + 3 : mp - 9;
+  *anio = (int) yoe + era * 400 + (*mes <= 2);
+}
+
+/**
+ * @brief Escribe un tiempo unix en formato "YYYY-MM-DD hh:mm:ss" (19 caracteres).
+ * @param buf Destino (al menos 20 bytes).
+ */
+inline void formatearTimestamp(uint32_t epoch, char *buf, size_t n) {
+  int anio, mes, dia;
+  civilDesdeDias(epoch / 86400, &anio, &mes, &dia);
+  // Con epoch de 32 bits el año no pasa de 2106; acotar cada campo deja ver
+  // al compilador que caben en 19 caracteres
+  unsigned a = (unsigned) anio % 10000, m = (unsigned) mes % 100, d = (unsigned) dia % 100;
+  unsigned s = epoch % 86400;
+  snprintf(buf, n, "%04u-%02u-%02u %02u:%02u:%02u",
+           a, m, d, s / 3600, s / 60 % 60, s % 60);
+}
+
+/**
+ * @brief Escribe un tiempo unix en formato "dd/mm/yyyy hh:mm:ss".
+ * @param buf Destino (al menos 20 bytes).
+ */
+inline void formatearFechaHora(uint32_t epoch, char *buf, size_t n) {
+  int anio, mes, dia;
+  civilDesdeDias(epoch / 86400, &anio, &mes, &dia);
+  unsigned a = (unsigned) anio % 10000, m = (unsigned) mes % 100, d = (unsigned) dia % 100;  // Ver formatearTimestamp
+  unsigned s = epoch % 86400;
+  snprintf(buf, n, "%02u/%02u/%04u %02u:%02u:%02u",
+           d, m, a, s / 3600, s / 60 % 60, s % 60);
+}
+
+/**
+ * @brief Escribe v con dos dígitos en p.
+ */
+static inline void escribir2(char *p, int v) {
+  p[0] = '0' + v / 10;
+  p[1] = '0' + v % 10;
+}
+
+/**
+ * @brief Reescribe hh:mm:ss (posiciones 11 a 18) de las dos cadenas.
+ */
+inline void relojEscribirHora(uint32_t segundosDia) {
+  int hh = segundosDia / 3600;
+  int mm = (segundosDia / 60) % 60;
+  int ss = segundosDia % 60;
+  escribir2(relojTimestamp + 11, hh);
+  escribir2(relojTimestamp + 14, mm);
+  escribir2(relojTimestamp + 17, ss);
+  memcpy(relojFechaHora + 11, relojTimestamp + 11, 8);
+}
+
+/**
+ * @brief Pone las cadenas en el segundo epoch. Llamar con relojMux tomado.
+ *
+ * Dentro del mismo día solo cambian los dígitos de la hora; la fecha
+ * completa se recalcula al cambiar de día.
+ */
+inline void relojActualizarCache(uint32_t epoch) {
+  uint32_t t0 = esp_cpu_get_cycle_count();
+  if (epoch / 86400 != relojCacheEpoch / 86400) {
+    int anio, mes, dia;
+    civilDesdeDias(epoch / 86400, &anio, &mes, &dia);
+    escribir2(relojTimestamp, anio / 100);
+    escribir2(relojTimestamp + 2, anio % 100);
+    escribir2(relojTimestamp + 5, mes);
+    escribir2(relojTimestamp + 8, dia);
+    escribir2(relojFechaHora, dia);
+    escribir2(relojFechaHora + 3, mes);
+    memcpy(relojFechaHora + 6, relojTimestamp, 4);
+  }
+  relojEscribirHora(epoch % 86400);
+  relojCacheEpoch = epoch;
+  relojCiclosFormateo += esp_cpu_get_cycle_count() - t0;
+  relojFormateos++;
+}
+
+/**
+ * @brief Tiempo unix actual en microsegundos. Llamar con relojMux tomado.
+ *
+ * Nunca devuelve un valor menor que el anterior, aunque una corrección
+ * del RTC haya atrasado la base.
+ */
+inline int64_t relojAhoraUs() {
+  int64_t us = relojBaseUs + (esp_timer_get_time() - relojTBase);
+  if (us < relojUltimoUs) {
+    us = relojUltimoUs;
+  }
+  relojUltimoUs = us;
+  return us;
+}
+
+/**
+ * @brief Pone el reloj en el tiempo unix unixUs, tomado en el instante t de esp_timer.
+ */
+inline void relojSincronizar(int64_t unixUs, int64_t t) {
+  portENTER_CRITICAL(&relojMux);
+  relojBaseUs = unixUs;
+  relojTBase = t;
+  relojUltimaDisciplina = t;
+  relojUltimoUs = 0;
+  relojCacheEpoch = 0;
+  relojActualizarCache(unixUs / 1000000);
+  portEXIT_CRITICAL(&relojMux);
+}
+
+/**
+ * @brief Segundos unix actuales según el reloj de software.
+ */
+inline uint32_t relojEpoch() {
+  portENTER_CRITICAL(&relojMux);
+  uint32_t epoch = relojAhoraUs() / 1000000;
+  portEXIT_CRITICAL(&relojMux);
+  return epoch;
+}
+
+/**
+ * @brief Copia una de las cadenas de fecha, actualizada al segundo actual.
+ * @param cadena relojTimestamp o relojFechaHora.
+ */
+inline void relojCopiar(const char *cadena, char *buf, size_t n) {
+  char copia[20];
+  portENTER_CRITICAL(&relojMux);
+  uint32_t epoch = relojAhoraUs() / 1000000;
+  if (epoch != relojCacheEpoch) {
+    relojActualizarCache(epoch);
+  }
+  memcpy(copia, cadena, sizeof(copia));
+  relojConsultas++;
+  portEXIT_CRITICAL(&relojMux);
+  snprintf(buf, n, "%s", copia);
+}
+
+/**
+ * @brief Obtiene la fecha y hora actual del reloj de software.
+ * @param buf Destino, en formato "dd/mm/yyyy hh:mm:ss".
+ * @param n Tamaño de buf.
+ */
+inline void obtenerFechaHora(char *buf, size_t n) {
+  relojCopiar(relojFechaHora, buf, n);
+}
+
+/**
+ * @brief Escribe el timestamp usado en el registro CSV.
+ *
+ * Sale del reloj de software, disciplinado por el RTC; no hay lectura I2C.
+ */
+inline void getTimestampFromRTC(char *buf, size_t n) {
+  relojCopiar(relojTimestamp, buf, n);
+}
+
+#endif
@@ -0,0 +1,154 @@
+/**
+ * @file bench_funciones.cpp
+ * @brief Microbenchmarks en Linux de las funciones puras de los nodos.
+ *
+ * Compila las cabeceras de los sketches contra el simulador (pruebas/simulador)
+ * y las mide con Google Benchmark. logSensorData escribe en una tarjeta SD
+ * simulada sobre un directorio temporal que se borra al terminar.
+ *
+ * Salida JSON para comparar entre commits:
+ *   cmake --build build --target bench_json
+ * o directamente:
+ *   bench_funciones --benchmark_out=bench.json --benchmark_out_format=json
+ */
+
+#include <Arduino.h>
+#include <SD.h>
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+
+#include "../prueba_3_corete/control.h"
+#include "../prueba_3_corete/reloj.h"
+#include "../prueba_3_corete/registro_sd.h"
+
+// Las constantes del nodo de sensores van en otro espacio de nombres
+namespace nucleo {
+#include "../nucleo_temp_hum_lum/muestreo.h"
+}
+
+#include "bench_revision.h"  // Generado en cada compilación por revision.cmake
+
+static const Lecturas lecturasTipo = {24.5f, 55.0f, 3000, 900.0f, 70.0f, 1, {0, 0, 0, 0, 0},
+                                      VALIDO_TEMP | VALIDO_HUM | VALIDO_LUM | VALIDO_CO2 | VALIDO_SUELO};
+static const SensorData datosTipo = {24.5f, 55.0f, 3000, 900.0f, 70.0f};
+static const char *const timestampTipo = "2025-06-12 08:33:01";
+
+static void BM_formatearLecturaSensores(benchmark::State &estado) {
+  char buf[256];
+  for (auto _ : estado) {
+    int n = formatearLecturaSensores(buf, sizeof(buf), "12/06/2025 08:33:01",
+                                     24.5f, 55.0f, 3000, 900.0f, 70.0f);
+    benchmark::DoNotOptimize(n);
+  }
+}
+BENCHMARK(BM_formatearLecturaSensores);
+
+static void BM_variablesEnvio(benchmark::State &estado) {
+  ComandoGrupo comando = {TIPO_COMANDO_GRUPO, NUM_ACTUADORES, 0, {0}};
+  for (auto _ : estado) {
+    struct_message2 salida = variablesEnvio(&cfgPorDefecto, lecturasTipo, 0, &comando);
+    benchmark::DoNotOptimize(salida);
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_variablesEnvio);
+
+static void BM_formatearMensajeAlarma(benchmark::State &estado) {
+  char msg[520];
+  for (auto _ : estado) {
+    int n = formatearMensajeAlarma(msg, sizeof(msg), lecturasTipo, lecturasTipo.validez);
+    benchmark::DoNotOptimize(n);
+  }
+}
+BENCHMARK(BM_formatearMensajeAlarma);
+
+static void BM_calcularCO2(benchmark::State &estado) {
+  int adc = 1;
+  for (auto _ : estado) {
+    float ppm = nucleo::calcularCO2(adc);
+    benchmark::DoNotOptimize(ppm);
+    adc = adc % 4094 + 1;  // Recorre todo el rango válido del ADC
+  }
+}
+BENCHMARK(BM_calcularCO2);
+
+static void BM_formatearTimestamp(benchmark::State &estado) {
+  char buf[20];
+  uint32_t epoch = 1749717181;
+  for (auto _ : estado) {
+    formatearTimestamp(epoch++, buf, sizeof(buf));
+    benchmark::DoNotOptimize(buf);
+  }
+}
+BENCHMARK(BM_formatearTimestamp);
+
+static void BM_getTimestampFromRTC(benchmark::State &estado) {
+  char buf[20];
+  for (auto _ : estado) {
+    getTimestampFromRTC(buf, sizeof(buf));
+    benchmark::DoNotOptimize(buf);
+  }
+}
+BENCHMARK(BM_getTimestampFromRTC);
+
+static void BM_getFolderPath(benchmark::State &estado) {
+  char buf[20];
+  for (auto _ : estado) {
+    getFolderPath(timestampTipo, buf, sizeof(buf));
+    benchmark::DoNotOptimize(buf);
+  }
+}
+BENCHMARK(BM_getFolderPath);
+
+static void BM_formatearLineaCSV(benchmark::State &estado) {
+  char buf[96];
+  for (auto _ : estado) {
+    int n = formatearLineaCSV(buf, sizeof(buf), timestampTipo, "NODE1", -60, datosTipo);
+    benchmark::DoNotOptimize(n);
+  }
+}
+BENCHMARK(BM_formatearLineaCSV);
+
+static void BM_leerLecturas(benchmark::State &estado) {
+  publicarLecturas(lecturasTipo);
+  for (auto _ : estado) {
+    Lecturas l = leerLecturas();
+    benchmark::DoNotOptimize(l);
+  }
+}
+BENCHMARK(BM_leerLecturas);
+
+static void BM_logSensorData(benchmark::State &estado) {
+  for (auto _ : estado) {
+    bool ok = logSensorData(timestampTipo, "NODE1", -60, datosTipo);
+    benchmark::DoNotOptimize(ok);
+  }
+}
+BENCHMARK(BM_logSensorData);
+
+int main(int argc, char **argv) {
+  sim::tiempoReal = true;
+  relojSincronizar(1749717181LL * 1000000, esp_timer_get_time());
+
+  char plantilla[] = "/tmp/bench_sd_XXXXXX";
+  if (mkdtemp(plantilla) == nullptr) {
+    perror("mkdtemp");
+    return 1;
+  }
+  sim::raizSD = plantilla;
+  if (!initSD()) {
+    return 1;
+  }
+
+  benchmark::AddCustomContext("revision", BENCH_REVISION);
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  std::filesystem::remove_all(plantilla);
+  return 0;
+}
@@ -0,0 +1,312 @@
+/**
+ * @file prueba_alarma.cpp
+ * @brief Cadena de la alarma de fuego de extremo a extremo, con la ventana WiFi del nodo central.
+ *
+ * Simulación de eventos discretos en pasos de 1 ms. Las decisiones son las
+ * funciones de los nodos: alarmaPorEnviar, estadoUmbrales,
+ * planificadorEnvioAlarma, planificadorMuestra y planificadorConfirmar del
+ * sensor; alarmaEvaluar, alarmaCaducar, alarmaArmarTrama y
+ * ventanaWiFiPermitida del nodo central; alarmaRecibirCritica y salidasAplicar del actuador. Lo que se
+ * modela es el reparto de tiempo: los periodos de trabajoAlarma y
+ * trabajoEnvio, cuándo despierta tareaAlarmaCritica (cambio, fin de ventana o
+ * refrescoAlarma, con sus reintentosAlarma copias) y la radio, donde cada
+ * trama tarda aire ms y se pierde si llega al nodo central con ESP-NOW
+ * apagado. La confirmación al sensor llega con la trama.
+ */
+
+#include <Arduino.h>
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <vector>
+
+#include "../prueba_3_corete/alarma_critica.h"
+
+// ConfigBlob es común; la trama de grupo y las constantes de cada nodo van en otro espacio de nombres
+namespace nucleo {
+#include "../nucleo_temp_hum_lum/muestreo.h"
+}
+namespace actuador {
+#include "../actuadores/comandos.h"
+}
+
+// La cota del nodo central usa los tiempos del sensor: deben ser los mismos
+static_assert(periodoAlarmaSensor == (int) nucleo::periodoAlarma, "periodoAlarma distinto");
+static_assert(periodoMuestreoSensor == (int) nucleo::periodoMuestreo, "periodoMuestreo distinto");
+static_assert(latidoAlarmaSensor == (int) nucleo::latidoAlarma, "latidoAlarma distinto");
+static_assert(histeresisAlarma == (int) nucleo::histeresisAlarma, "histeresisAlarma distinta");
+
+static const uint32_t sinVentana = UINT32_MAX;
+static const uint32_t nunca = UINT32_MAX;
+static const uint32_t aire = 5;  // ms de cada trama ESP-NOW, de esp_now_send a OnDataRecv
+
+/**
+ * @brief Condiciones de una simulación.
+ */
+struct Escenario {
+  std::function<float(uint32_t)> luz;  ///< Valor del LDR en cada ms
+  uint32_t pideVentana;                ///< ms en que telegramToca pide la primera ventana
+  uint32_t cadaVentana;                ///< ms entre peticiones siguientes (0 = solo una)
+  uint32_t duracionVentana;
+  bool mismoCanal;                     ///< El punto de acceso usa el canal de ESP-NOW
+  uint32_t calla;                      ///< ms desde el que el sensor deja de transmitir
+  uint32_t fin;                        ///< ms simulados
+};
+
+/**
+ * @brief Lo observado en una simulación.
+ */
+struct Resultado {
+  uint32_t cruce = UINT32_MAX;    ///< Primer ms con el LDR por encima de lumAlarma
+  uint32_t salida = UINT32_MAX;   ///< Primer ms con el patrón de alarma en las salidas
+  uint32_t apagado = UINT32_MAX;  ///< Primer ms tras salida sin el patrón de alarma
+  uint32_t recibida = 0;          ///< ms de la última trama del sensor recibida
+  uint32_t cambiosCentral = 0;    ///< Cambios de estado en alarmaEvaluar
+  uint32_t cambiosSensor = 0;     ///< Cambios del bit UMBRAL_ALARMA enviado
+  uint32_t tramasSensor = 0;
+  uint32_t tramasPerdidas = 0;
+  uint32_t ventanas = 0;          ///< Ventanas WiFi abiertas
+  uint32_t ventanasNegadas = 0;   ///< Peticiones rechazadas por ventanaWiFiPermitida
+  uint32_t ultimaVentana = UINT32_MAX;  ///< ms en que se abrió la última ventana
+  nucleo::Planificador p = {};
+};
+
+/**
+ * @brief Trama en el aire: del sensor al nodo central o crítica hacia los actuadores.
+ */
+struct Trama {
+  uint32_t llega;
+  bool critica;
+  float lum;
+  actuador::ComandoGrupo grupo;
+};
+
+/// Estado inicial de los tres nodos: sin alarma y con las salidas apagadas.
+static void reiniciar() {
+  sim::relojUs = 0;
+  alarmaCritica = false;
+  alarmaPendiente = false;
+  comandoCritico.secuencia = 0;
+  actuador::Alarma = false;
+  actuador::alarmaEnclavada = false;
+  actuador::alarmaCambio = false;
+  actuador::haySecuenciaCritica = false;
+  actuador::nodoId = 0;
+  actuador::salidasIniciar(actuador::MASCARA_SEGMENTOS, 0);
+}
+
+static Resultado simular(const Escenario &e) {
+  reiniciar();
+  Resultado r;
+  const ConfigBlob *cfgSensor = &cfgPorDefecto;
+  const uint8_t validez = VALIDO_TEMP | VALIDO_HUM | VALIDO_LUM | VALIDO_CO2 | VALIDO_SUELO;
+  std::vector<Trama> aireLibre;
+  Lecturas lecturas = {};
+  uint32_t finVentana = 0;
+  uint32_t ultimoRefresco = 0;
+  bool escuchabaAntes = true;
+
+  for (uint32_t t = 0; t < e.fin; t++, sim::avanzar(1000)) {
+    bool escucha = t >= finVentana;
+    float lum = e.luz(t);
+    if (r.cruce == UINT32_MAX && lum > cfgPorDefecto.lumAlarma) {
+      r.cruce = t;
+    }
+
+    // Radio: tramas que llegan en este ms
+    for (size_t i = 0; i < aireLibre.size();) {
+      Trama tr = aireLibre[i];
+      if (tr.llega != t) {
+        i++;
+        continue;
+      }
+      aireLibre.erase(aireLibre.begin() + i);
+      if (tr.critica) {
+        // Actuador: OnDataRecv con la trama crítica y tareaSalidas al despertar
+        actuador::alarmaRecibirCritica(tr.grupo);
+        if (actuador::alarmaCambio) {
+          actuador::salidasAplicar();
+        }
+        continue;
+      }
+      // Sensor: OnDataSent; dentro de la ventana solo confirma la radio del mismo canal
+      nucleo::planificadorConfirmar(&r.p, escucha || e.mismoCanal);
+      if (!escucha) {
+        r.tramasPerdidas++;
+        continue;
+      }
+      // Nodo central: OnDataRecv
+      r.recibida = t;
+      lecturas.lum = (int) tr.lum;
+      lecturas.validez = validez;
+      for (int c = 0; c < NUM_CAMPOS; c++) {
+        lecturas.marcaMs[c] = t;
+      }
+      if (alarmaEvaluar(&cfgPorDefecto, (int) tr.lum)) {
+        r.cambiosCentral++;
+      }
+    }
+
+    // Sensor: trabajoAlarma y trabajoEnvio (enviarLecturas) en su orden
+    auto enviar = [&](bool antes) {
+      r.cambiosSensor += (bool) (r.p.estadoEnviado & UMBRAL_ALARMA) != antes;
+      r.tramasSensor++;
+      aireLibre.push_back({t + aire, false, lum, {}});
+    };
+    float v[NUM_VARIABLES] = {24, 50, lum, 900, 70};
+    bool transmite = t < e.calla;
+    if (transmite && t % nucleo::periodoAlarma == 0 && nucleo::alarmaPorEnviar(&r.p, cfgSensor, lum)) {
+      bool antes = r.p.estadoEnviado & UMBRAL_ALARMA;
+      uint16_t estado = nucleo::estadoUmbrales(cfgSensor, v, r.p.estadoEnviado) | (validez << 8);
+      nucleo::planificadorEnvioAlarma(&r.p, estado, t);
+      enviar(antes);
+    }
+    if (transmite && t % nucleo::periodoMuestreo == 0) {
+      bool antes = r.p.estadoEnviado & UMBRAL_ALARMA;
+      uint16_t estado = nucleo::estadoUmbrales(cfgSensor, v, r.p.estadoEnviado) | (validez << 8);
+      if (nucleo::planificadorMuestra(&r.p, v, estado, t)) {
+        enviar(antes);
+      }
+    }
+
+    // Nodo central: tareaAlarmaCritica, despertada por un cambio, por
+    // switchToESPNow al cerrar la ventana o por refrescoAlarma
+    bool reabre = escucha && !escuchabaAntes;
+    escuchabaAntes = escucha;
+    bool despierta = alarmaPendiente || reabre || t - ultimoRefresco >= (uint32_t) refrescoAlarma;
+    if (despierta) {
+      alarmaCaducar(lecturas, t);
+    }
+    bool cambio = alarmaPendiente || reabre;
+    if (escucha && despierta) {
+      alarmaPendiente = false;
+      alarmaArmarTrama(&comandoCritico);
+      ultimoRefresco = t;
+      int copias = cambio ? reintentosAlarma : 1;
+      for (int i = 0; i < copias; i++) {
+        Trama tr = {t + aire + i * separacionReintentos, true, 0, {}};
+        memcpy(&tr.grupo, &comandoCritico, sizeof(tr.grupo));
+        aireLibre.push_back(tr);
+      }
+    }
+
+    // Nodo central: taskESPNow abre la ventana cuando telegramToca lo pide
+    bool pide = e.pideVentana != sinVentana && t >= e.pideVentana &&
+                (t == e.pideVentana || (e.cadaVentana > 0 && (t - e.pideVentana) % e.cadaVentana == 0));
+    if (pide && escucha) {
+      if (ventanaWiFiPermitida()) {
+        finVentana = t + e.duracionVentana;
+        r.ventanas++;
+        r.ultimaVentana = t;
+      } else {
+        r.ventanasNegadas++;
+      }
+    }
+
+    bool patron = (actuador::salidasActual & actuador::MASCARA_SEGMENTOS) == actuador::PATRON_ALARMA;
+    if (r.salida == UINT32_MAX && patron) {
+      r.salida = t;
+    }
+    if (r.salida != UINT32_MAX && r.apagado == UINT32_MAX && !patron) {
+      r.apagado = t;
+    }
+  }
+  return r;
+}
+
+/// Escalón del LDR de 3000 a 3800 en el ms indicado.
+static std::function<float(uint32_t)> escalon(uint32_t en) {
+  return [en](uint32_t t) { return t < en ? 3000.0f : 3800.0f; };
+}
+
+TEST(Alarma, ConESPNowActivoLlegaDentroDeLaCota) {
+  Resultado r = simular({escalon(10037), sinVentana, 0, 0, false, nunca, 20000});
+  ASSERT_NE(r.salida, UINT32_MAX);
+  EXPECT_LE(r.salida - r.cruce, (uint32_t) cotaAlarma);
+  EXPECT_EQ(r.cambiosCentral, 1u);
+  EXPECT_EQ(r.p.enviosFallidos, 0u);
+}
+
+TEST(Alarma, NoSeAbreLaVentanaConLaAlarmaActiva) {
+  // Telegram pide una ventana de 2 s cada 3 s; el fuego va de 9,5 s a 20 s,
+  // fuera de las ventanas de 7 s y de 19 s en adelante
+  auto fuego = [](uint32_t t) { return t >= 9500 && t < 20000 ? 3800.0f : 3000.0f; };
+  Resultado r = simular({fuego, 1000, 3000, 2000, false, nunca, 30000});
+  ASSERT_NE(r.salida, UINT32_MAX);
+  EXPECT_LE(r.salida - r.cruce, (uint32_t) cotaAlarma);
+  // Se niegan las de 10 s a 19 s y se vuelven a abrir al terminar la alarma
+  EXPECT_EQ(r.ventanasNegadas, 4u);
+  EXPECT_EQ(r.ultimaVentana, 28000u);
+  EXPECT_FALSE(actuador::Alarma);
+}
+
+TEST(Alarma, FuegoDentroDeUnaVentanaEnOtroCanal) {
+  // El fuego empieza justo al apagarse ESP-NOW: el sensor reintenta hasta que vuelve
+  Resultado r = simular({escalon(10001), 10000, 0, (uint32_t) ventanaWiFiMax, false, nunca, 30000});
+  ASSERT_NE(r.salida, UINT32_MAX);
+  EXPECT_GE(r.salida, 10000u + ventanaWiFiMax);
+  EXPECT_LE(r.salida - r.cruce, (uint32_t) cotaAlarmaVentana);
+  EXPECT_GT(r.p.enviosFallidos, 0u);
+  EXPECT_GT(r.tramasPerdidas, 0u);
+  printf("otro canal: cruce a %u ms, alarma a %u ms (ventana %d ms, cota %d ms), %u tramas perdidas\n",
+         (unsigned) r.cruce, (unsigned) r.salida, ventanaWiFiMax, cotaAlarmaVentana, (unsigned) r.tramasPerdidas);
+}
+
+TEST(Alarma, VentanaEnElMismoCanalLaCubreElLatido) {
+  // Subida lenta (sin cambio rápido) que cruza dentro de la ventana: la radio
+  // confirma tramas que el nodo central no procesa
+  auto rampa = [](uint32_t t) { return 3480.0f + 0.002f * t; };
+  Resultado r = simular({rampa, 10000, 0, (uint32_t) ventanaWiFiMax, true, nunca, 40000});
+  ASSERT_GT(r.cruce, 10000u);
+  ASSERT_NE(r.salida, UINT32_MAX);
+  EXPECT_GE(r.salida, 10000u + ventanaWiFiMax);
+  EXPECT_LE(r.salida - r.cruce, (uint32_t) cotaAlarmaVentana);
+  EXPECT_GT(r.tramasPerdidas, 0u);
+  EXPECT_EQ(r.p.enviosFallidos, 0u);
+  printf("mismo canal: cruce a %u ms, alarma a %u ms (ventana %d ms, cota %d ms)\n",
+         (unsigned) r.cruce, (unsigned) r.salida, ventanaWiFiMax, cotaAlarmaVentana);
+}
+
+TEST(Alarma, RuidoAlrededorDelUmbralNoHaceParpadear) {
+  // Tras el cruce el LDR oscila ±60 cuentas alrededor de lumAlarma + 20
+  auto ruido = [](uint32_t t) {
+    if (t < 5000) {
+      return 3000.0f;
+    }
+    uint32_t x = t / nucleo::periodoAlarma * 2654435761u;
+    return 3520.0f + (float) ((x >> 16) % 121) - 60.0f;
+  };
+  Resultado r = simular({ruido, sinVentana, 0, 0, false, nunca, 60000});
+  ASSERT_NE(r.salida, UINT32_MAX);
+  EXPECT_EQ(r.cambiosCentral, 1u);
+  EXPECT_EQ(r.cambiosSensor, 1u);
+  EXPECT_TRUE(actuador::Alarma);
+}
+
+TEST(Alarma, CaducaSiElSensorCalla) {
+  // El sensor se apaga con el fuego activo: el nodo central deja de repetir
+  // "fuego" cuando la luz pasa de maxEdadLectura y el actuador lo apaga
+  Resultado r = simular({escalon(5000), sinVentana, 0, 0, false, 20000, 20000 + maxEdadLectura + 5000});
+  ASSERT_NE(r.salida, UINT32_MAX);
+  ASSERT_NE(r.apagado, UINT32_MAX);
+  EXPECT_GE(r.apagado, r.recibida + maxEdadLectura);
+  EXPECT_LE(r.apagado, r.recibida + maxEdadLectura + refrescoAlarma + aire);
+  EXPECT_FALSE(alarmaCritica);
+  EXPECT_FALSE(actuador::Alarma);
+  // El canal crítico sigue vigente, ahora con la alarma apagada
+  EXPECT_TRUE(actuador::alarmaCanalVigente());
+}
+
+TEST(Alarma, CaducaPorEdadNoPorUnaLuzInvalida) {
+  reiniciar();
+  alarmaCritica = true;
+  Lecturas l = {};
+  l.marcaMs[2] = 1000;       // Última luz buena
+  l.validez = VALIDO_TEMP;   // La última trama trajo el LDR inválido
+  EXPECT_FALSE(alarmaCaducar(l, 1000 + maxEdadLectura - 1));
+  EXPECT_TRUE(alarmaCritica);
+  EXPECT_TRUE(alarmaCaducar(l, 1000 + maxEdadLectura));
+  EXPECT_FALSE(alarmaCritica);
+  EXPECT_TRUE(alarmaPendiente);
+  EXPECT_FALSE(alarmaCaducar(l, 1000 + maxEdadLectura + 1));
+}
@@ -0,0 +1,196 @@
+/**
+ * @file prueba_compactacion.cpp
+ * @brief Compactación, diezmado y retención de la SD simulada, con y sin
+ * espacio en la tarjeta y tras cortes a mitad de compactación.
+ */
+
+#include <Arduino.h>
+#include <SD.h>
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "../prueba_3_corete/compactacion_sd.h"
+#include "../prueba_3_corete/reloj.h"
+
+static const char *const dia = "2025-06-10";
+
+class Compactacion : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char plantilla[] = "/tmp/prueba_sd_XXXXXX";
+    ASSERT_NE(mkdtemp(plantilla), nullptr);
+    sim::raizSD = plantilla;
+    sim::sdBytesLibres = -1;
+    ASSERT_TRUE(initSD());
+    SensorData datos = {24.5f, 55.0f, 3000, 900.0f, 70.0f};
+    for (int h = 8; h <= 9; h++) {
+      for (int s = 0; s < 30; s++) {
+        char ts[20];
+        snprintf(ts, sizeof(ts), "%s %02d:%02d:%02d", dia, h, s / 6, (s % 6) * 10);
+        ASSERT_TRUE(logSensorData(ts, "NODE1", -60, datos));
+      }
+    }
+  }
+
+  void TearDown() override {
+    sim::sdBytesLibres = -1;
+    std::filesystem::remove_all(sim::raizSD);
+  }
+
+  /// Contenido de un archivo de la tarjeta ("" si no existe).
+  static std::string leer(const std::string &ruta) {
+    std::ifstream f(sim::raizSD + ruta, std::ios::binary);
+    std::stringstream s;
+    s << f.rdbuf();
+    return s.str();
+  }
+
+  /// Líneas de datos (las que empiezan por un dígito) de un archivo.
+  static int lineasDatos(const std::string &texto) {
+    int n = 0;
+    std::istringstream s(texto);
+    for (std::string l; std::getline(s, l);) {
+      n += !l.empty() && l[0] >= '0' && l[0] <= '9';
+    }
+    return n;
+  }
+
+  /// Veces que aparece un texto.
+  static int veces(const std::string &texto, const std::string &buscado) {
+    int n = 0;
+    for (size_t p = texto.find(buscado); p != std::string::npos; p = texto.find(buscado, p + 1)) {
+      n++;
+    }
+    return n;
+  }
+
+  /// Pone el reloj a las 12:00 del día que está a edad días de dia y hace una pasada de compactarSD.
+  static void pasadaConEdad(int edad) {
+    int64_t epoch = (int64_t) (diasDesdeCivil(2025, 6, 10) + edad) * 86400 + 12 * 3600;
+    relojSincronizar(epoch * 1000000, esp_timer_get_time());
+    compactarSD();
+  }
+
+  static bool compactar(bool diezmar) {
+    tramoTomar();
+    bool ok = compactarDia(dia, diezmar);
+    tramoSoltar();
+    return ok;
+  }
+};
+
+TEST_F(Compactacion, ReuneLasHorasEnUnArchivo) {
+  ASSERT_TRUE(compactar(false));
+  std::string datos = leer("/2025-06-10/data.csv");
+  EXPECT_NE(datos.find("# resumen 2025-06-10 08 n=30"), std::string::npos);
+  EXPECT_NE(datos.find("# resumen 2025-06-10 09 n=30"), std::string::npos);
+  EXPECT_TRUE(archivoTerminado("/2025-06-10/data.csv"));
+  EXPECT_FALSE(SD.exists("/2025-06-10/08"));
+  EXPECT_FALSE(SD.exists("/2025-06-10/09"));
+  EXPECT_FALSE(SD.exists("/2025-06-10/data.tmp"));
+}
+
+TEST_F(Compactacion, TarjetaLlenaConservaLasHoras) {
+  std::string hora8 = leer("/2025-06-10/08/data.csv");
+  std::string hora9 = leer("/2025-06-10/09/data.csv");
+  sim::sdBytesLibres = 1000;  // Cabe el principio de data.tmp pero no la marca de fin
+
+  EXPECT_FALSE(compactar(false));
+  EXPECT_FALSE(SD.exists("/2025-06-10/data.tmp"));
+  EXPECT_FALSE(SD.exists("/2025-06-10/data.csv"));
+  EXPECT_EQ(leer("/2025-06-10/08/data.csv"), hora8);
+  EXPECT_EQ(leer("/2025-06-10/09/data.csv"), hora9);
+
+  // Con espacio, la siguiente pasada compacta el día completo
+  sim::sdBytesLibres = -1;
+  ASSERT_TRUE(compactar(false));
+  EXPECT_NE(leer("/2025-06-10/data.csv").find("# resumen 2025-06-10 09 n=30"), std::string::npos);
+}
+
+TEST_F(Compactacion, TarjetaLlenaConservaElDataCSVPrevio) {
+  ASSERT_TRUE(compactar(false));
+  std::string previo = leer("/2025-06-10/data.csv");
+  // Una hora que llega tarde y una SD que se llena al promediar a 1 minuto
+  SensorData datos = {25.0f, 50.0f, 2900, 950.0f, 65.0f};
+  ASSERT_TRUE(logSensorData("2025-06-10 10:00:00", "NODE1", -61, datos));
+  sim::sdBytesLibres = 200;
+
+  EXPECT_FALSE(compactar(true));
+  EXPECT_EQ(leer("/2025-06-10/data.csv"), previo);
+  EXPECT_TRUE(SD.exists("/2025-06-10/10/data.csv"));
+  EXPECT_FALSE(SD.exists("/2025-06-10/data.tmp"));
+}
+
+TEST_F(Compactacion, ElDiaEnCursoNoSeCompacta) {
+  // Sus horas siguen abiertas a logSensorData; se compacta pasada la medianoche
+  pasadaConEdad(0);
+  EXPECT_TRUE(SD.exists("/2025-06-10/08/data.csv"));
+  EXPECT_FALSE(SD.exists("/2025-06-10/data.csv"));
+  pasadaConEdad(1);
+  EXPECT_FALSE(SD.exists("/2025-06-10/08"));
+  EXPECT_EQ(lineasDatos(leer("/2025-06-10/data.csv")), 60);
+}
+
+TEST_F(Compactacion, DiezmaLosDiasDeMasDeUnaSemana) {
+  pasadaConEdad(1);
+  std::string datos = leer("/2025-06-10/data.csv");
+  EXPECT_EQ(datos.rfind("# resolucion original", 0), 0u);
+  EXPECT_EQ(lineasDatos(datos), 60);
+
+  // Con diasDiezmado de edad se promedia a 1 minuto: 6 lecturas por minuto,
+  // 5 minutos por hora; los resúmenes de hora se conservan tal cual
+  pasadaConEdad(diasDiezmado - 1);
+  EXPECT_EQ(leer("/2025-06-10/data.csv"), datos);
+  pasadaConEdad(diasDiezmado);
+  datos = leer("/2025-06-10/data.csv");
+  EXPECT_EQ(datos.rfind(RESOLUCION_MINUTO, 0), 0u);
+  EXPECT_EQ(lineasDatos(datos), 10);
+  EXPECT_NE(datos.find("2025-06-10 08:04:00,NODE1,-60,24.50,55.00,3000,900.00,70.00"), std::string::npos);
+  EXPECT_EQ(veces(datos, "# resumen 2025-06-10 08 n=30"), 1);
+  EXPECT_EQ(veces(datos, "# resumen 2025-06-10 09 n=30"), 1);
+  EXPECT_TRUE(archivoTerminado("/2025-06-10/data.csv"));
+
+  // Un día ya diezmado no se vuelve a escribir
+  pasadaConEdad(diasDiezmado + 1);
+  EXPECT_EQ(leer("/2025-06-10/data.csv"), datos);
+}
+
+TEST_F(Compactacion, BorraLosDiasDeMasDeLaRetencion) {
+  SensorData datos = {25.0f, 50.0f, 2900, 950.0f, 65.0f};
+  ASSERT_TRUE(logSensorData("2025-06-11 08:00:00", "NODE1", -61, datos));
+  pasadaConEdad(1);
+  ASSERT_TRUE(SD.exists("/2025-06-10/data.csv"));
+
+  // 2025-06-10 llega a diasRetencion; 2025-06-11 se queda un día por debajo
+  pasadaConEdad(diasRetencion);
+  EXPECT_FALSE(SD.exists("/2025-06-10"));
+  EXPECT_TRUE(SD.exists("/2025-06-11/data.csv"));
+  EXPECT_FALSE(SD.exists("/2025-06-11/08"));
+}
+
+TEST_F(Compactacion, RecuperaUnTmpTerminadoSinDataCSV) {
+  // Corte entre borrar data.csv y renombrar data.tmp: el día solo tiene data.tmp
+  ASSERT_TRUE(compactar(false));
+  std::string compactado = leer("/2025-06-10/data.csv");
+  std::filesystem::rename(sim::raizSD + "/2025-06-10/data.csv", sim::raizSD + "/2025-06-10/data.tmp");
+
+  pasadaConEdad(1);
+  EXPECT_FALSE(SD.exists("/2025-06-10/data.tmp"));
+  EXPECT_EQ(leer("/2025-06-10/data.csv"), compactado);
+}
+
+TEST_F(Compactacion, DescartaUnTmpAMedias) {
+  // Corte mientras se escribía data.tmp: sin marca de fin, las horas siguen ahí
+  std::ofstream(sim::raizSD + "/2025-06-10/data.tmp") << "# resolucion original\r\n" CABECERA_CSV "\r\n"
+                                                      << "2025-06-10 08:00:00,NODE1,-60,24.50,55.00,3000,900.00,70.00\r\n";
+  pasadaConEdad(1);
+  std::string datos = leer("/2025-06-10/data.csv");
+  EXPECT_FALSE(SD.exists("/2025-06-10/data.tmp"));
+  EXPECT_EQ(lineasDatos(datos), 60);
+  EXPECT_EQ(veces(datos, "# resumen 2025-06-10 08 n=30"), 1);
+  EXPECT_EQ(veces(datos, "# resumen 2025-06-10 09 n=30"), 1);
+}
@@ -0,0 +1,91 @@
+/**
+ * @file prueba_config.cpp
+ * @brief Pruebas de ConfigBlob: CRC, firma, origen y formato hexadecimal.
+ */
+
+#include <Arduino.h>
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "../prueba_3_corete/config_blob.h"
+
+static const uint8_t macIntrusa[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+
+/// Configuración firmada con la clave de compilación y generación 7.
+static ConfigBlob configFirmada() {
+  ConfigBlob c = cfgPorDefecto;
+  c.generacion = 7;
+  c.lumAlarma = 3600;
+  cfgFirmar(&c);
+  return c;
+}
+
+TEST(Config, CRCComoElDeLaROM) {
+  // esp_rom_crc32_le(0, ...) es el CRC-32 de zlib: mismo valor de control
+  const char *control = "123456789";
+  EXPECT_EQ(crc32(0, (const Bytef *) control, 9), 0xCBF43926u);
+}
+
+TEST(Config, FirmadaEsValida) {
+  ConfigBlob c = configFirmada();
+  EXPECT_EQ(c.version, CFG_VERSION);
+  EXPECT_EQ(c.longitud, sizeof(ConfigBlob));
+  EXPECT_TRUE(cfgEsValida(&c));
+}
+
+TEST(Config, CRCRecalculadoNoBastaSinClave) {
+  ConfigBlob c = configFirmada();
+  c.tempMax = 60;
+  c.crc = cfgCalcularCRC(&c);
+  EXPECT_FALSE(cfgEsValida(&c));
+}
+
+TEST(Config, OtraClaveSeRechaza) {
+  ConfigBlob c = cfgPorDefecto;
+  c.generacion = 7;
+  cfgFirmar(&c, "otra-clave");
+  EXPECT_FALSE(cfgEsValida(&c));
+}
+
+TEST(Config, SoloSeAceptaDelNodoCentral) {
+  ConfigBlob c = configFirmada();
+  ConfigBlob nueva;
+  const uint8_t *datos = (const uint8_t *) &c;
+  EXPECT_EQ(cfgEvaluar(datos, sizeof(c), cfgPorDefecto.macNucleoC, &cfgPorDefecto, &nueva), CFG_ACEPTADA);
+  EXPECT_EQ(memcmp(&nueva, &c, sizeof(c)), 0);
+  EXPECT_EQ(cfgEvaluar(datos, sizeof(c), macIntrusa, &cfgPorDefecto, &nueva), CFG_ORIGEN_DESCONOCIDO);
+  // Puerto serie del nodo central
+  EXPECT_EQ(cfgEvaluar(datos, sizeof(c), NULL, &cfgPorDefecto, &nueva), CFG_ACEPTADA);
+}
+
+TEST(Config, GeneracionAntiguaYOtrosMensajes) {
+  ConfigBlob c = configFirmada();
+  ConfigBlob nueva;
+  const uint8_t *datos = (const uint8_t *) &c;
+  EXPECT_EQ(cfgEvaluar(datos, sizeof(c), NULL, &c, &nueva), CFG_ANTIGUA);
+  EXPECT_EQ(cfgEvaluar(datos, sizeof(c) - CFG_TAM_FIRMA, NULL, &cfgPorDefecto, &nueva), CFG_NO_ES_CONFIG);
+
+  ConfigBlob alterada = c;
+  alterada.firma[0] ^= 1;
+  EXPECT_EQ(cfgEvaluar((const uint8_t *) &alterada, sizeof(c), NULL, &cfgPorDefecto, &nueva), CFG_INVALIDA);
+}
+
+TEST(Config, HexadecimalIdaYVuelta) {
+  ConfigBlob c = configFirmada();
+  char hex[2 * sizeof(ConfigBlob) + 1];
+  cfgAHex(&c, hex, sizeof(hex));
+  EXPECT_EQ(strlen(hex), 2 * sizeof(ConfigBlob));
+
+  ConfigBlob leida;
+  ASSERT_TRUE(cfgDesdeHex(hex, &leida));
+  EXPECT_EQ(memcmp(&leida, &c, sizeof(c)), 0);
+
+  std::string corta(hex, 2 * sizeof(ConfigBlob) - 2);
+  EXPECT_FALSE(cfgDesdeHex(corta.c_str(), &leida));
+  std::string larga = std::string(hex) + "00";
+  EXPECT_FALSE(cfgDesdeHex(larga.c_str(), &leida));
+  std::string mala(hex);
+  mala[10] = 'g';
+  EXPECT_FALSE(cfgDesdeHex(mala.c_str(), &leida));
+}
@@ -0,0 +1,91 @@
+/**
+ * @file prueba_control.cpp
+ * @brief Decisiones del nodo central con campos inválidos o viejos.
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "../prueba_3_corete/control.h"
+
+static const uint8_t todos = VALIDO_TEMP | VALIDO_HUM | VALIDO_LUM | VALIDO_CO2 | VALIDO_SUELO;
+
+/// Lecturas dentro de todos los umbrales de cfgPorDefecto, leídas en marca.
+static Lecturas lecturasNormales(uint32_t marca) {
+  return {24, 50, 3000, 900, 70, 1, {marca, marca, marca, marca, marca}, todos};
+}
+
+TEST(Control, TodoEnRangoNoEnciendeNada) {
+  Lecturas l = lecturasNormales(1000);
+  struct_message2 s = calcularSalidas(&cfgPorDefecto, l, lecturasUsables(l, 2000));
+  EXPECT_FALSE(s.eVentilador || s.eCalor || s.eAlarma || s.eLed || s.eBomba);
+  EXPECT_FALSE(limitesSuperados(&cfgPorDefecto, l, 2000));
+}
+
+TEST(Control, UmbralesConLecturasUsables) {
+  Lecturas l = lecturasNormales(1000);
+  l.temp = 10;
+  l.CO2 = 2500;
+  l.lum = 3900;
+  l.valHumsuelo = 20;
+  struct_message2 s = calcularSalidas(&cfgPorDefecto, l, lecturasUsables(l, 2000));
+  EXPECT_TRUE(s.eCalor);
+  EXPECT_TRUE(s.eVentilador);
+  EXPECT_TRUE(s.eAlarma);
+  EXPECT_TRUE(s.eBomba);
+  EXPECT_TRUE(limitesSuperados(&cfgPorDefecto, l, 2000));
+}
+
+TEST(Control, DHTMuertoDesdeElArranque) {
+  // Sin ninguna lectura del DHT temp y hum valen 0: antes encendían la
+  // calefacción y mandaban Telegram en cada ciclo
+  Lecturas l = lecturasNormales(1000);
+  l.temp = 0;
+  l.hum = 0;
+  l.validez = todos & ~(VALIDO_TEMP | VALIDO_HUM);
+  l.marcaMs[0] = l.marcaMs[1] = 0;
+  uint8_t u = lecturasUsables(l, 2000);
+  EXPECT_EQ(u, todos & ~(VALIDO_TEMP | VALIDO_HUM));
+
+  struct_message2 s = calcularSalidas(&cfgPorDefecto, l, u);
+  EXPECT_FALSE(s.eCalor);
+  EXPECT_FALSE(s.eVentilador);
+  EXPECT_FALSE(limitesSuperados(&cfgPorDefecto, l, 2000));
+
+  char msg[520];
+  formatearMensajeAlarma(msg, sizeof(msg), l, u);
+  EXPECT_NE(std::string(msg).find("Temp: -- °C"), std::string::npos) << msg;
+  EXPECT_NE(std::string(msg).find("Humedad: -- %"), std::string::npos) << msg;
+  EXPECT_NE(std::string(msg).find("Luz: 3000"), std::string::npos) << msg;
+}
+
+TEST(Control, LecturaViejaDejaDeDecidir) {
+  // El último CO2 bueno estaba alto y el sensor dejó de responder: el
+  // ventilador no debe quedarse encendido para siempre
+  Lecturas l = lecturasNormales(1000);
+  l.CO2 = 2500;
+  ComandoGrupo c = {TIPO_COMANDO_GRUPO, NUM_ACTUADORES, 0, {0}};
+  EXPECT_TRUE(variablesEnvio(&cfgPorDefecto, l, 1000 + maxEdadLectura - 1, &c).eVentilador);
+  EXPECT_EQ(c.salidas[0], SAL_VENTILADOR);
+
+  uint32_t tarde = 1000 + maxEdadLectura;
+  struct_message2 s = variablesEnvio(&cfgPorDefecto, l, tarde, &c);
+  EXPECT_FALSE(s.eVentilador);
+  EXPECT_EQ(c.salidas[0], 0);
+  EXPECT_EQ(lecturasUsables(l, tarde), 0);
+  EXPECT_FALSE(limitesSuperados(&cfgPorDefecto, l, tarde));
+}
+
+TEST(Control, CampoInvalidoEnLaUltimaTramaNoEspera) {
+  Lecturas l = lecturasNormales(1000);
+  l.valHumsuelo = 20;
+  l.validez &= ~VALIDO_SUELO;  // El nodo de sensores avisa de que ya no es válido
+  struct_message2 s = calcularSalidas(&cfgPorDefecto, l, lecturasUsables(l, 1500));
+  EXPECT_FALSE(s.eBomba);
+}
+
+TEST(Control, EdadConVueltaDeMillis) {
+  Lecturas l = lecturasNormales(0xFFFFFF00u);
+  EXPECT_EQ(lecturasUsables(l, 0x100), todos);
+}
@@ -0,0 +1,125 @@
+/**
+ * @file prueba_importador.cpp
+ * @brief importador_csv sobre un árbol de la SD con días a medio compactar.
+ *
+ * Ejecuta el importador compilado (IMPORTADOR) sobre un directorio temporal y
+ * lee timestamp.col y bloques.idx.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+
+#ifndef IMPORTADOR
+#define IMPORTADOR "importador_csv"
+#endif
+
+namespace fs = std::filesystem;
+
+static const char *const cabecera = "timestamp,nodeId,rssi,temp,hum,light,co2ppm,soilMoisture";
+
+class Importador : public ::testing::Test {
+ protected:
+  fs::path raiz;
+  fs::path salida;
+  std::string informe;  ///< Salida estándar del importador
+
+  void SetUp() override {
+    char plantilla[] = "/tmp/prueba_importador_XXXXXX";
+    ASSERT_NE(mkdtemp(plantilla), nullptr);
+    raiz = fs::path(plantilla) / "sd";
+    salida = fs::path(plantilla) / "salida";
+  }
+
+  void TearDown() override {
+    fs::remove_all(raiz.parent_path());
+  }
+
+  void escribir(const std::string &ruta, const std::vector<std::string> &lineas) {
+    fs::path p = raiz / ruta;
+    fs::create_directories(p.parent_path());
+    std::ofstream f(p);
+    for (const std::string &l : lineas) {
+      f << l << "\r\n";
+    }
+  }
+
+  /// Ejecuta el importador y devuelve su código de salida.
+  int importar() {
+    std::string orden = std::string(IMPORTADOR) + " " + raiz.string() + " " + salida.string() + " -j 4";
+    FILE *p = popen(orden.c_str(), "r");
+    if (p == NULL) {
+      return -1;
+    }
+    char buf[256];
+    while (fgets(buf, sizeof(buf), p) != NULL) {
+      informe += buf;
+    }
+    return WEXITSTATUS(pclose(p));
+  }
+
+  /// Valores de 64 bits tras la cabecera (timestamp.col, o bloques.idx con campos = 3).
+  std::vector<int64_t> leerColumna(const char *nombre, size_t campos = 1) {
+    std::ifstream f(salida / nombre, std::ios::binary);
+    char cab[24];
+    f.read(cab, sizeof(cab));
+    std::vector<int64_t> v;
+    int64_t x[3];
+    while (f.read((char *) x, campos * sizeof(int64_t))) {
+      for (size_t i = 0; i < campos; i++) {
+        v.push_back(x[i]);
+      }
+    }
+    return v;
+  }
+};
+
+TEST_F(Importador, UneCadaDiaEnOrdenYSinRepetidas) {
+  // Día compactado con las horas 07 y 10; después llegaron las horas 08 y 09
+  // y la hora 07 quedó sin borrar (compactación cortada antes del borrado)
+  escribir("2025-06-10/data.csv", {
+    "# resolucion original", cabecera,
+    "2025-06-10 07:00:01,NODE1,-60,24.00,55.00,3000,900.00,70.00",
+    "# resumen 2025-06-10 07 n=1",
+    "2025-06-10 10:00:00,NODE1,-60,25.00,50.00,3000,900.00,70.00",
+    "2025-06-10 09:00:01,NODE1,-61,24.50,52.00,3000,905.00,69.00",
+    "# resumen 2025-06-10 10 n=1",
+    "# fin"});
+  escribir("2025-06-10/07/data.csv", {cabecera, "2025-06-10 07:00:01,NODE1,-60,24.00,55.00,3000,900.00,70.00"});
+  escribir("2025-06-10/08/data.csv", {cabecera,
+    "2025-06-10 08:00:00,NODE1,-60,24.10,54.00,3000,900.00,70.00",
+    "2025-06-10 08:00:01,NODE2,-70,24.20,54.00,3000,900.00,70.00"});
+  // La misma lectura que ya está en data.csv, sin su resumen
+  escribir("2025-06-10/09/data.csv", {cabecera, "2025-06-10 09:00:01,NODE1,-61,24.50,52.00,3000,905.00,69.00"});
+  escribir("2025-06-11/00/data.csv", {cabecera, "2025-06-11 00:00:01,NODE1,-60,23.00,60.00,0,800.00,72.00"});
+
+  ASSERT_EQ(importar(), 0) << informe;
+  std::vector<int64_t> ts = leerColumna("timestamp.col");
+  std::vector<int64_t> esperado = {1749538801, 1749542400, 1749542401, 1749546001, 1749549600, 1749600001};
+  EXPECT_EQ(ts, esperado);
+  EXPECT_NE(informe.find("filas repetidas=1 "), std::string::npos) << informe;
+  EXPECT_NE(informe.find("fuera de orden entre dias=0"), std::string::npos) << informe;
+
+  // Un solo bloque con el rango completo
+  std::vector<int64_t> bloques = leerColumna("bloques.idx", 3);
+  ASSERT_EQ(bloques.size(), 3u);
+  EXPECT_EQ(bloques[1], esperado.front());
+  EXPECT_EQ(bloques[2], esperado.back());
+}
+
+TEST_F(Importador, LecturasDistintasEnElMismoSegundoSeConservan) {
+  escribir("2025-06-10/08/data.csv", {cabecera,
+    "2025-06-10 08:00:00,NODE1,-60,24.10,54.00,3000,900.00,70.00",
+    "2025-06-10 08:00:00,NODE1,-60,24.10,54.00,3700,900.00,70.00",
+    "2025-06-10 08:00:00,NODE1,-60,24.10,54.00,3000,900.00,70.00"});
+  ASSERT_EQ(importar(), 0) << informe;
+  EXPECT_EQ(leerColumna("timestamp.col").size(), 2u);
+  EXPECT_NE(informe.find("filas repetidas=1 "), std::string::npos) << informe;
+}
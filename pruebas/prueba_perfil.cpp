@@ -0,0 +1,112 @@
+/**
+ * @file prueba_perfil.cpp
+ * @brief Simulación del perfilador de tareas con tiempo virtual.
+ *
+ * Una tarea de periodo nominal 500 ms se simula ciclo a ciclo con
+ * sim::avanzar; se comprueban periodo min/med/max, excesos (más de un 10 %
+ * sobre el nominal), ocupación y el reinicio tras cada reporte.
+ */
+
+#include <Arduino.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "../prueba_3_corete/perfil.h"
+
+static const int64_t ms = 1000;
+
+/**
+ * @brief Simula ciclos de una tarea: cada uno marca, trabaja y espera.
+ * @param periodos Duración de cada ciclo en ms (trabajo incluido).
+ * @param trabajoMs Parte de cada ciclo dentro del trabajo.
+ */
+static void simular(PerfilTarea *p, const std::vector<int> &periodos, int trabajoMs) {
+  for (int periodo : periodos) {
+    perfilMarcar(p);
+    perfilInicioTrabajo(p);
+    sim::avanzar(trabajoMs * ms);
+    perfilFinTrabajo(p);
+    sim::avanzar((periodo - trabajoMs) * ms);
+  }
+  perfilMarcar(p);  // Cierra el último periodo
+}
+
+class Perfil : public ::testing::Test {
+ protected:
+  PerfilTarea p = perfilNuevo("Prueba", 4096, 500);
+
+  void SetUp() override {
+    sim::relojUs = 1000 * ms;  // Las marcas en 0 significan "sin marcar"
+  }
+};
+
+TEST_F(Perfil, PeriodosYExcesos) {
+  std::vector<int> periodos(20, 500);
+  periodos.push_back(540);  // Dentro del 10 %
+  periodos.push_back(600);  // Exceso
+  periodos.push_back(480);
+  simular(&p, periodos, 50);
+
+  PerfilTarea r = perfilTomar(&p);
+  EXPECT_EQ(r.ciclos, periodos.size());
+  EXPECT_EQ(r.minUs, 480 * ms);
+  EXPECT_EQ(r.maxUs, 600 * ms);
+  EXPECT_EQ(r.sumaUs, (20 * 500 + 540 + 600 + 480) * ms);
+  EXPECT_EQ(r.excesos, 1u);
+  // 50 ms de cada ciclo: 23 ciclos de trabajo en la ventana
+  EXPECT_EQ(r.ocupadoUs, 23 * 50 * ms);
+  EXPECT_EQ(r.ventanaUs, r.sumaUs);
+  EXPECT_NEAR(perfilOcupacion(r), 23 * 50 * 100.0 / (r.sumaUs / ms), 0.01);
+}
+
+TEST_F(Perfil, ElReporteReiniciaLaVentana) {
+  simular(&p, std::vector<int>(10, 700), 100);
+  PerfilTarea primera = perfilTomar(&p);
+  EXPECT_EQ(primera.excesos, 10u);
+
+  simular(&p, std::vector<int>(10, 500), 25);
+  PerfilTarea segunda = perfilTomar(&p);
+  // El primer periodo de la segunda ventana empieza en la última marca de la primera
+  EXPECT_EQ(segunda.ciclos, 11u);
+  EXPECT_EQ(segunda.excesos, 0u);
+  EXPECT_EQ(segunda.maxUs, 500 * ms);
+  EXPECT_EQ(segunda.ocupadoUs, 10 * 25 * ms);
+  EXPECT_NEAR(perfilOcupacion(segunda), 5.0, 0.01);
+}
+
+TEST_F(Perfil, TrabajoEnCursoSeReparteEntreVentanas) {
+  perfilMarcar(&p);
+  perfilInicioTrabajo(&p);
+  sim::avanzar(300 * ms);
+  PerfilTarea primera = perfilTomar(&p);
+  sim::avanzar(200 * ms);
+  perfilFinTrabajo(&p);
+  sim::avanzar(300 * ms);
+  PerfilTarea segunda = perfilTomar(&p);
+
+  EXPECT_EQ(primera.ocupadoUs, 300 * ms);
+  EXPECT_NEAR(perfilOcupacion(primera), 100.0, 0.01);
+  EXPECT_EQ(segunda.ocupadoUs, 200 * ms);
+  EXPECT_EQ(segunda.ventanaUs, 500 * ms);
+}
+
+TEST_F(Perfil, ReporteImpreso) {
+  std::vector<int> periodos(4, 500);
+  periodos.push_back(700);
+  simular(&p, periodos, 100);
+
+  sim::capturarSerie = true;
+  sim::salidaSerie.clear();
+  PerfilTarea r = perfilReportarPeriodo(&p);
+  sim::capturarSerie = false;
+
+  EXPECT_EQ(r.excesos, 1u);
+  EXPECT_NE(sim::salidaSerie.find("min/med/max 500/540/700 ms"), std::string::npos) << sim::salidaSerie;
+  EXPECT_NE(sim::salidaSerie.find("excesos 1/5"), std::string::npos) << sim::salidaSerie;
+  EXPECT_NE(sim::salidaSerie.find("ocupada 18.5%"), std::string::npos) << sim::salidaSerie;
+  // Contadores a cero para el siguiente reporte
+  EXPECT_EQ(p.ciclos, 0u);
+  EXPECT_EQ(p.excesos, 0u);
+  EXPECT_EQ(p.ocupadoUs, 0);
+}
@@ -0,0 +1,126 @@
+/**
+ * @file prueba_salidas.cpp
+ * @brief Escrituras a registros del puerto de salidas del nodo de actuadores y su id de nodo.
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+/**
+ * @brief Una escritura a un registro W1TS/W1TC.
+ */
+struct Escritura {
+  uint32_t reg;
+  uint32_t valor;
+};
+
+static std::vector<Escritura> escrituras;
+
+#define SALIDAS_ESCRIBIR_REGISTRO(reg, valor) escrituras.push_back({(uint32_t) (reg), (valor)})
+#include "../actuadores/puerto_salidas.h"
+#include "../actuadores/comandos.h"
+
+/// Puerto con todas las salidas en bajo y el registro de escrituras vacío.
+class Salidas : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    salidasIniciar(BIT_PIN(RELAY_BOMBA) | BIT_PIN(RELAY_VENTILADOR) | BIT_PIN(LED_PIN) |
+                   BIT_PIN(AIRE) | MASCARA_SEGMENTOS, 0);
+    escrituras.clear();
+    salidasEscrituras = 0;
+    salidasOmitidas = 0;
+  }
+};
+
+TEST_F(Salidas, PatronDeAlarmaEnDosEscrituras) {
+  salidasActualizar(MASCARA_SEGMENTOS, PATRON_ALARMA);
+  // a, e, f en el banco 0 y g (GPIO 33) en el banco 1; nada que quitar
+  ASSERT_EQ(escrituras.size(), 2u);
+  EXPECT_EQ(escrituras[0].reg, (uint32_t) GPIO_OUT_W1TS_REG);
+  EXPECT_EQ(escrituras[0].valor, (uint32_t) (BIT_PIN(a) | BIT_PIN(e) | BIT_PIN(f)));
+  EXPECT_EQ(escrituras[1].reg, (uint32_t) GPIO_OUT1_W1TS_REG);
+  EXPECT_EQ(escrituras[1].valor, 1u << (g - 32));
+  EXPECT_EQ(salidasEscrituras, 2u);
+
+  // Apagar la alarma: las mismas dos escrituras en los registros de borrado
+  escrituras.clear();
+  salidasActualizar(MASCARA_SEGMENTOS, 0);
+  ASSERT_EQ(escrituras.size(), 2u);
+  EXPECT_EQ(escrituras[0].reg, (uint32_t) GPIO_OUT_W1TC_REG);
+  EXPECT_EQ(escrituras[1].reg, (uint32_t) GPIO_OUT1_W1TC_REG);
+}
+
+TEST_F(Salidas, SinCambiosNoSeEscribe) {
+  salidasActualizar(MASCARA_SEGMENTOS, PATRON_ALARMA);
+  escrituras.clear();
+  salidasActualizar(MASCARA_SEGMENTOS, PATRON_ALARMA);
+  salidasActualizar(BIT_PIN(LED_PIN), 0);
+  EXPECT_EQ(escrituras.size(), 0u);
+  EXPECT_EQ(salidasOmitidas, 2u);
+}
+
+TEST_F(Salidas, UnSoloPinDelBanco0) {
+  salidasActualizar(BIT_PIN(LED_PIN), BIT_PIN(LED_PIN));
+  ASSERT_EQ(escrituras.size(), 1u);
+  EXPECT_EQ(escrituras[0].reg, (uint32_t) GPIO_OUT_W1TS_REG);
+  EXPECT_EQ(escrituras[0].valor, 1u << LED_PIN);
+}
+
+TEST_F(Salidas, Pin33VaAlBanco1) {
+  salidasActualizar(BIT_PIN(g), BIT_PIN(g));
+  ASSERT_EQ(escrituras.size(), 1u);
+  EXPECT_EQ(escrituras[0].reg, (uint32_t) GPIO_OUT1_W1TS_REG);
+  EXPECT_EQ(escrituras[0].valor, 1u << 1);
+}
+
+TEST_F(Salidas, OtrosGruposNoSeTocan) {
+  salidasActualizar(BIT_PIN(LED_PIN), BIT_PIN(LED_PIN));
+  salidasActualizar(MASCARA_SEGMENTOS, PATRON_ALARMA);
+  escrituras.clear();
+  // Quitar la alarma no apaga el LED
+  salidasActualizar(MASCARA_SEGMENTOS, 0);
+  EXPECT_EQ(salidasActual, BIT_PIN(LED_PIN));
+  for (const Escritura &w : escrituras) {
+    EXPECT_FALSE(w.reg == (uint32_t) GPIO_OUT_W1TC_REG && (w.valor & (1u << LED_PIN)));
+  }
+}
+
+TEST_F(Salidas, TodasLasSalidasEnUnaActualizacion) {
+  // Arranque con todo apagado: relés activos en bajo en HIGH
+  Ventilador = Bomba = Led = Calor = Alarma = false;
+  salidasIniciar(MASCARA_SALIDAS, salidasCalcular());
+  escrituras.clear();
+
+  // Trama que cambia a la vez ventilador, LED, aire y alarma
+  Ventilador = Led = Calor = Alarma = true;
+  salidasAplicar();
+  // Un par set/clear en el banco 0 y el set de g en el banco 1
+  ASSERT_EQ(escrituras.size(), 3u);
+  EXPECT_EQ(escrituras[0].reg, (uint32_t) GPIO_OUT_W1TS_REG);
+  EXPECT_EQ(escrituras[0].valor, (uint32_t) (BIT_PIN(LED_PIN) | BIT_PIN(AIRE) |
+                                             BIT_PIN(a) | BIT_PIN(e) | BIT_PIN(f)));
+  EXPECT_EQ(escrituras[1].reg, (uint32_t) GPIO_OUT_W1TC_REG);
+  EXPECT_EQ(escrituras[1].valor, (uint32_t) BIT_PIN(RELAY_VENTILADOR));
+  EXPECT_EQ(escrituras[2].reg, (uint32_t) GPIO_OUT1_W1TS_REG);
+  EXPECT_EQ(salidasActual, salidasCalcular());
+
+  // La siguiente pasada sin cambios no escribe nada
+  escrituras.clear();
+  salidasAplicar();
+  EXPECT_EQ(escrituras.size(), 0u);
+}
+
+TEST(Nodo, IdPorPuertoSerie) {
+  uint8_t id = NODO_SIN_ID;
+  EXPECT_TRUE(nodoLeerLinea("NODO 3", &id));
+  EXPECT_EQ(id, 3);
+  EXPECT_TRUE(nodoLeerLinea("NODO 0", &id));
+  EXPECT_EQ(id, 0);
+  // Fuera de la trama, con texto de más o de otro comando: no cambia
+  EXPECT_FALSE(nodoLeerLinea("NODO 64", &id));
+  EXPECT_FALSE(nodoLeerLinea("NODO 2x", &id));
+  EXPECT_FALSE(nodoLeerLinea("NODO", &id));
+  EXPECT_FALSE(nodoLeerLinea("CFG 0011", &id));
+  EXPECT_EQ(id, 0);
+}
@@ -0,0 +1,124 @@
+/**
+ * @file prueba_seqlock.cpp
+ * @brief Prueba de estrés del seqlock de lecturas.h con varios hilos.
+ *
+ * Un hilo hace de OnDataRecv publicando sin pausa y los demás de tareas
+ * lectoras. Todos los campos de cada juego derivan del número de trama, así
+ * que una copia con campos de dos tramas distintas se detecta.
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../prueba_3_corete/lecturas.h"
+
+static const int lectoresEstres = 3;
+static const auto duracionEstres = std::chrono::milliseconds(300);
+
+/// Juego de lecturas de la trama k; los float son exactos hasta 2^20.
+static Lecturas lecturasDeTrama(uint32_t k) {
+  float base = (float) (k & 0xFFFFF);
+  return {base, base + 1, (int) (k & 0xFFFFF), base + 2, base + 3, k,
+          {k, k + 1, k + 2, k + 3, k + 4}, (uint8_t) (k & 0x1F)};
+}
+
+static bool coherente(const Lecturas &l) {
+  Lecturas e = lecturasDeTrama(l.trama);
+  return l.temp == e.temp && l.hum == e.hum && l.lum == e.lum && l.CO2 == e.CO2 &&
+         l.valHumsuelo == e.valHumsuelo && l.validez == e.validez &&
+         memcmp(l.marcaMs, e.marcaMs, sizeof(l.marcaMs)) == 0;
+}
+
+/**
+ * @brief Resultado de un hilo lector.
+ */
+struct Lector {
+  uint64_t lecturas = 0;
+  uint64_t rotas = 0;        ///< Campos de tramas distintas
+  uint64_t retrocesos = 0;   ///< Trama anterior a una ya leída
+};
+
+TEST(Seqlock, SinLecturasRotasConEscritorContinuo) {
+  publicarLecturas(lecturasDeTrama(1));
+  lecturasReintentos = 0;
+
+  std::atomic<bool> fin(false);
+  std::vector<Lector> lectores(lectoresEstres);
+  std::vector<std::thread> hilos;
+  for (int i = 0; i < lectoresEstres; i++) {
+    hilos.emplace_back([&fin, &r = lectores[i]] {
+      uint32_t ultima = 0;
+      while (!fin.load(std::memory_order_relaxed)) {
+        Lecturas l = leerLecturas();
+        r.lecturas++;
+        if (!coherente(l)) {
+          r.rotas++;
+        }
+        if (l.trama < ultima) {
+          r.retrocesos++;
+        }
+        ultima = l.trama;
+      }
+    });
+  }
+
+  uint32_t publicadas = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  while (std::chrono::steady_clock::now() - t0 < duracionEstres) {
+    for (int i = 0; i < 64; i++) {
+      publicarLecturas(lecturasDeTrama(2 + publicadas++));
+    }
+  }
+  fin = true;
+  for (std::thread &h : hilos) {
+    h.join();
+  }
+
+  uint64_t lecturas = 0;
+  for (const Lector &r : lectores) {
+    EXPECT_EQ(r.rotas, 0u);
+    EXPECT_EQ(r.retrocesos, 0u);
+    EXPECT_GT(r.lecturas, 0u);
+    lecturas += r.lecturas;
+  }
+  printf("%u publicaciones, %llu lecturas, %u reintentos (%.4f por lectura)\n",
+         (unsigned) publicadas, (unsigned long long) lecturas, (unsigned) lecturasReintentos.load(),
+         (double) lecturasReintentos.load() / lecturas);
+}
+
+TEST(Seqlock, CosteDeLectura) {
+  publicarLecturas(lecturasDeTrama(7));
+  const int repeticiones = 1000000;
+
+  // Sin escritor: el coste de la ruta normal del lector
+  uint32_t suma = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeticiones; i++) {
+    suma += leerLecturas().trama;
+  }
+  double libre = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / repeticiones;
+  EXPECT_EQ(suma, 7u * repeticiones);
+
+  // Con un escritor publicando en otro hilo
+  std::atomic<bool> fin(false);
+  std::thread escritor([&fin] {
+    for (uint32_t k = 8; !fin.load(std::memory_order_relaxed); k++) {
+      publicarLecturas(lecturasDeTrama(k));
+    }
+  });
+  uint64_t rotas = 0;
+  t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeticiones; i++) {
+    rotas += !coherente(leerLecturas());
+  }
+  double conEscritor = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / repeticiones;
+  fin = true;
+  escritor.join();
+
+  EXPECT_EQ(rotas, 0u);
+  printf("leerLecturas: %.1f ns sin escritor, %.1f ns con escritor continuo\n", libre, conEscritor);
+}
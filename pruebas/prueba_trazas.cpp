@@ -0,0 +1,150 @@
+/**
+ * @file prueba_trazas.cpp
+ * @brief Reproduce trazas del nodo de sensores a través del planificador de envíos.
+ *
+ * Las trazas de pruebas/trazas tienen el formato CSV de la SD, una lectura por
+ * segundo; son sintéticas (generar_trazas.py, con el ruido de cada sensor).
+ * Se comprueba cuántas tramas se envían y con qué retraso sale el cruce de
+ * lumAlarma, con los umbrales de compilación y un enlace que entrega todas
+ * las tramas.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../nucleo_temp_hum_lum/muestreo.h"
+
+#ifndef TRAZAS_DIR
+#define TRAZAS_DIR "trazas"
+#endif
+
+/**
+ * @brief Una lectura de la traza.
+ */
+struct Muestra {
+  uint32_t ms;
+  float v[NUM_VARIABLES];
+};
+
+/**
+ * @brief Resultado de reproducir una traza.
+ */
+struct Reproduccion {
+  Planificador p;
+  std::vector<uint32_t> envios;   ///< ms de cada trama enviada
+  uint32_t rapidosTrasCalma;      ///< Envíos por cambio rápido pasado el arranque
+};
+
+static std::vector<Muestra> leerTraza(const char *nombre) {
+  std::vector<Muestra> traza;
+  std::string ruta = std::string(TRAZAS_DIR) + "/" + nombre;
+  FILE *f = fopen(ruta.c_str(), "r");
+  if (f == NULL) {
+    return traza;
+  }
+  char linea[128];
+  fgets(linea, sizeof(linea), f);  // Cabecera
+  while (fgets(linea, sizeof(linea), f) != NULL) {
+    Muestra m;
+    m.ms = traza.size() * periodoMuestreo;
+    if (sscanf(linea, "%*[^,],%*[^,],%*d,%f,%f,%f,%f,%f",
+               &m.v[0], &m.v[1], &m.v[2], &m.v[3], &m.v[4]) == NUM_VARIABLES) {
+      traza.push_back(m);
+    }
+  }
+  fclose(f);
+  return traza;
+}
+
+static Reproduccion reproducir(const std::vector<Muestra> &traza) {
+  Reproduccion r = {};
+  const uint16_t validez = VALIDO_TEMP | VALIDO_HUM | VALIDO_LUM | VALIDO_CO2 | VALIDO_SUELO;
+  for (const Muestra &m : traza) {
+    uint32_t rapidos = r.p.enviosRapidos;
+    uint16_t estado = estadoUmbrales(&cfgPorDefecto, m.v, r.p.estadoEnviado) | (validez << 8);
+    if (planificadorMuestra(&r.p, m.v, estado, m.ms)) {
+      planificadorConfirmar(&r.p, true);
+      r.envios.push_back(m.ms);
+      if (r.p.enviosRapidos != rapidos && m.ms >= tiempoCalma) {
+        r.rapidosTrasCalma++;
+      }
+    }
+  }
+  return r;
+}
+
+TEST(Trazas, EstableSoloEnviaLatidosYBanda) {
+  std::vector<Muestra> traza = leerTraza("estable.csv");
+  ASSERT_EQ(traza.size(), 3600u);
+  Reproduccion r = reproducir(traza);
+
+  // El ruido de los sensores no debe dejar el nodo en modo rápido
+  EXPECT_EQ(r.rapidosTrasCalma, 0u);
+  // Arranque (tiempoCalma) + un latido por minuto + algunos por banda muerta
+  size_t maximo = tiempoCalma / periodoMuestreo + 3600000 / latidoLento + 60;
+  EXPECT_LE(r.envios.size(), maximo);
+  EXPECT_EQ(r.p.enviosReintento, 0u);
+  printf("estable: %zu tramas en 1 h (umbral %u, rápidos %u, banda %u, latido %u)\n",
+         r.envios.size(), (unsigned) r.p.enviosUmbral, (unsigned) r.p.enviosRapidos,
+         (unsigned) r.p.enviosBanda, (unsigned) r.p.enviosLatido);
+}
+
+TEST(Trazas, IncendioSeEnviaEnLaMuestraDelCruce) {
+  std::vector<Muestra> traza = leerTraza("incendio.csv");
+  ASSERT_EQ(traza.size(), 600u);
+  Reproduccion r = reproducir(traza);
+
+  uint32_t cruce = UINT32_MAX;
+  for (const Muestra &m : traza) {
+    if (m.v[2] > cfgPorDefecto.lumAlarma) {
+      cruce = m.ms;
+      break;
+    }
+  }
+  ASSERT_NE(cruce, UINT32_MAX);
+
+  uint32_t envio = UINT32_MAX;
+  for (uint32_t t : r.envios) {
+    if (t >= cruce) {
+      envio = t;
+      break;
+    }
+  }
+  // Latencia del planificador: cero muestras tras el cruce
+  EXPECT_EQ(envio, cruce);
+  // La subida de la llama sí es un cambio rápido
+  EXPECT_GT(r.rapidosTrasCalma, 0u);
+  EXPECT_LE(r.envios.size(), 200u);
+  printf("incendio: cruce a %u ms enviado a %u ms, %zu tramas en 10 min\n",
+         (unsigned) cruce, (unsigned) envio, r.envios.size());
+}
+
+TEST(Trazas, EnvioDeAlarmaNoEsUnaMuestra) {
+  // Valores quietos cada periodoMuestreo y un envío de alarma entre dos muestras
+  float v[NUM_VARIABLES] = {24, 50, 3000, 900, 70};
+  Planificador p = {};
+  for (uint32_t t = 0; t <= 40000; t += periodoMuestreo) {
+    planificadorMuestra(&p, v, estadoUmbrales(&cfgPorDefecto, v, p.estadoEnviado), t);
+    planificadorConfirmar(&p, true);
+  }
+  uint32_t muestras = p.muestras;
+  float v2[NUM_VARIABLES] = {24, 50, 3800, 900, 70};
+  ASSERT_TRUE(alarmaPorEnviar(&p, &cfgPorDefecto, v2[2]));
+  uint16_t estado = estadoUmbrales(&cfgPorDefecto, v2, p.estadoEnviado);
+  planificadorEnvioAlarma(&p, estado, 40100);
+  EXPECT_EQ(p.muestras, muestras);
+  EXPECT_EQ(p.tMuestra, 40000u);
+  EXPECT_TRUE(p.enVuelo);
+  EXPECT_EQ(p.estadoEnviado, estado);
+  EXPECT_FLOAT_EQ(p.anterior[2], 3000);
+  EXPECT_FLOAT_EQ(p.pendiente[2], 0);
+  planificadorConfirmar(&p, true);
+  EXPECT_FALSE(alarmaPorEnviar(&p, &cfgPorDefecto, v2[2]));
+
+  // La siguiente muestra mide la pendiente sobre su periodo, no sobre 900 ms
+  planificadorMuestra(&p, v2, estado, 41000);
+  EXPECT_FLOAT_EQ(p.pendiente[2], suavizado * 800);
+}
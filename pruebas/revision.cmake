@@ -0,0 +1,21 @@
+# Escribe SALIDA con la revisión de git actual como BENCH_REVISION.
+#
+# Se ejecuta en cada compilación (cmake -P desde el objetivo bench_revision)
+# y solo reescribe el archivo si la revisión cambió, para no recompilar
+# bench_funciones sin motivo.
+execute_process(COMMAND git rev-parse --short HEAD
+                WORKING_DIRECTORY ${RAIZ}
+                OUTPUT_VARIABLE revision
+                OUTPUT_STRIP_TRAILING_WHITESPACE
+                ERROR_QUIET)
+if(NOT revision)
+  set(revision desconocida)
+endif()
+
+set(contenido "#define BENCH_REVISION \"${revision}\"\n")
+if(EXISTS ${SALIDA})
+  file(READ ${SALIDA} anterior)
+endif()
+if(NOT contenido STREQUAL anterior)
+  file(WRITE ${SALIDA} "${contenido}")
+endif()
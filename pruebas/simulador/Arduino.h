@@ -0,0 +1,206 @@
+/**
+ * @file Arduino.h
+ * @brief Sustituto de Arduino.h y de FreeRTOS para compilar en Linux las
+ * cabeceras de los sketches (pruebas y benchmarks).
+ *
+ * Solo cubre lo que usan esas cabeceras. El tiempo es virtual: millis(),
+ * micros() y esp_timer_get_time() leen sim::relojUs, que solo avanza con
+ * delay(), vTaskDelay() o sim::avanzar(), así las pruebas son deterministas.
+ * Con sim::tiempoReal = true se usa el reloj monótono del sistema.
+ */
+#ifndef SIMULADOR_ARDUINO_H
+#define SIMULADOR_ARDUINO_H
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#define IRAM_ATTR
+
+namespace sim {
+
+/// Tiempo virtual en microsegundos desde el arranque.
+inline std::atomic<int64_t> relojUs(0);
+/// Usar el reloj del sistema en lugar del virtual.
+inline bool tiempoReal = false;
+
+/// Avanza el tiempo virtual.
+inline void avanzar(int64_t us) {
+  relojUs += us;
+}
+
+/// Guardar lo que se imprime por Serial en salidaSerie (si no, se descarta).
+inline bool capturarSerie = false;
+inline std::string salidaSerie;
+inline std::mutex serieMutex;
+
+/// Llamadas a xTaskNotifyGive, por si la prueba quiere saber que se despertó una tarea.
+inline std::atomic<uint32_t> notificaciones(0);
+
+}  // namespace sim
+
+inline int64_t esp_timer_get_time() {
+  if (sim::tiempoReal) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+  return sim::relojUs.load();
+}
+
+/// Como en el ESP32, millis() y micros() son de 32 bits y dan la vuelta.
+inline uint32_t millis() {
+  return (uint32_t) (esp_timer_get_time() / 1000);
+}
+
+inline uint32_t micros() {
+  return (uint32_t) esp_timer_get_time();
+}
+
+inline void delay(uint32_t ms) {
+  if (sim::tiempoReal) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  } else {
+    sim::avanzar(ms * 1000LL);
+  }
+}
+
+//----------FreeRTOS--------------------------------------------
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void *TaskHandle_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portTICK_PERIOD_MS 1
+#define tskIDLE_PRIORITY 0
+
+inline void vTaskDelay(TickType_t ticks) {
+  delay(ticks * portTICK_PERIOD_MS);
+}
+
+inline TickType_t xTaskGetTickCount() {
+  return millis() / portTICK_PERIOD_MS;
+}
+
+inline UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t) {
+  return 0;
+}
+
+inline void xTaskNotifyGive(TaskHandle_t) {
+  sim::notificaciones++;
+}
+
+/// Spinlock como el portMUX del ESP32 (sin anidamiento).
+typedef struct portMUX_TYPE {
+  std::atomic<int> ocupado;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {}
+
+inline void portENTER_CRITICAL(portMUX_TYPE *m) {
+  int libre = 0;
+  while (!m->ocupado.compare_exchange_weak(libre, 1, std::memory_order_acquire)) {
+    libre = 0;
+  }
+}
+
+inline void portEXIT_CRITICAL(portMUX_TYPE *m) {
+  m->ocupado.store(0, std::memory_order_release);
+}
+
+struct SemaforoSim {
+  std::mutex m;
+};
+typedef SemaforoSim *SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+  return new SemaforoSim;
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t espera) {
+  if (espera == portMAX_DELAY) {
+    s->m.lock();
+    return pdTRUE;
+  }
+  return s->m.try_lock() ? pdTRUE : pdFALSE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t s) {
+  s->m.unlock();
+  return pdTRUE;
+}
+
+//----------Serial----------------------------------------------
+class HardwareSerial {
+ public:
+  void begin(unsigned long) {}
+
+  size_t printf(const char *formato, ...) __attribute__((format(printf, 2, 3))) {
+    char buf[1024];
+    va_list args;
+    va_start(args, formato);
+    int n = vsnprintf(buf, sizeof(buf), formato, args);
+    va_end(args);
+    escribir(buf);
+    return n > 0 ? n : 0;
+  }
+
+  size_t print(const char *s) {
+    escribir(s);
+    return strlen(s);
+  }
+
+  size_t print(int v) {
+    return printf("%d", v);
+  }
+
+  size_t print(unsigned v) {
+    return printf("%u", v);
+  }
+
+  size_t print(double v) {
+    return printf("%.2f", v);
+  }
+
+  size_t println() {
+    return print("\r\n");
+  }
+
+  template <typename T>
+  size_t println(T v) {
+    size_t n = print(v);
+    return n + println();
+  }
+
+  int available() {
+    return 0;
+  }
+
+  int read() {
+    return -1;
+  }
+
+ private:
+  void escribir(const char *s) {
+    if (sim::capturarSerie) {
+      std::lock_guard<std::mutex> cerrojo(sim::serieMutex);
+      sim::salidaSerie += s;
+    }
+  }
+};
+
+inline HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,171 @@
+/**
+ * @file SD.h
+ * @brief Tarjeta SD del simulador sobre un directorio temporal de Linux.
+ *
+ * Imita la semántica de la librería SD del ESP32 (FAT) en lo que usan los
+ * sketches: rename falla si el destino existe, rmdir solo borra carpetas
+ * vacías y println devuelve los bytes escritos. Con sim::sdBytesLibres >= 0
+ * la tarjeta se llena al agotarse ese espacio y las escrituras se quedan cortas.
+ */
+#ifndef SIMULADOR_SD_H
+#define SIMULADOR_SD_H
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace sim {
+
+/// Directorio que hace de raíz de la tarjeta.
+inline std::string raizSD;
+/// Bytes que caben todavía en la tarjeta (-1 = sin límite).
+inline int64_t sdBytesLibres = -1;
+
+}  // namespace sim
+
+class File {
+ public:
+  File() {}
+
+  explicit operator bool() const {
+    return fp_ != nullptr || dir_;
+  }
+
+  size_t size() {
+    if (fp_) {
+      fflush(fp_.get());
+    }
+    std::error_code e;
+    auto n = std::filesystem::file_size(sim::raizSD + ruta_, e);
+    return e ? 0 : (size_t) n;
+  }
+
+  size_t println(const char *s) {
+    size_t n = escribir(s, strlen(s));
+    return n + escribir("\r\n", 2);
+  }
+
+  size_t read(uint8_t *buf, size_t n) {
+    return fp_ ? fread(buf, 1, n, fp_.get()) : 0;
+  }
+
+  bool seek(uint32_t pos) {
+    return fp_ && fseek(fp_.get(), pos, SEEK_SET) == 0;
+  }
+
+  void close() {
+    fp_.reset();
+    entradas_.reset();
+    dir_ = false;
+  }
+
+  bool isDirectory() {
+    return dir_;
+  }
+
+  const char *name() {
+    nombre_ = std::filesystem::path(ruta_).filename().string();
+    return nombre_.c_str();
+  }
+
+  File openNextFile() {
+    if (!entradas_ || siguiente_ >= entradas_->size()) {
+      return File();
+    }
+    std::string ruta = ruta_ + (ruta_ == "/" ? "" : "/") + (*entradas_)[siguiente_++];
+    return abrir(ruta, FILE_READ);
+  }
+
+  /// Abre ruta (relativa a la raíz de la tarjeta) como lo haría SD.open.
+  static File abrir(const std::string &ruta, const char *modo) {
+    File f;
+    f.ruta_ = ruta;
+    std::string real = sim::raizSD + ruta;
+    if (std::filesystem::is_directory(real)) {
+      f.dir_ = true;
+      f.entradas_ = std::make_shared<std::vector<std::string>>();
+      for (auto &e : std::filesystem::directory_iterator(real)) {
+        f.entradas_->push_back(e.path().filename().string());
+      }
+      std::sort(f.entradas_->begin(), f.entradas_->end());
+      return f;
+    }
+    const char *m = modo[0] == 'w' ? "wb" : modo[0] == 'a' ? "ab" : "rb";
+    FILE *fp = fopen(real.c_str(), m);
+    if (fp != nullptr) {
+      f.fp_.reset(fp, fclose);
+    }
+    return f;
+  }
+
+ private:
+  size_t escribir(const char *s, size_t n) {
+    if (!fp_) {
+      return 0;
+    }
+    if (sim::sdBytesLibres >= 0) {
+      n = std::min<size_t>(n, (size_t) sim::sdBytesLibres);
+      sim::sdBytesLibres -= n;
+    }
+    return n ? fwrite(s, 1, n, fp_.get()) : 0;
+  }
+
+  std::shared_ptr<FILE> fp_;
+  std::string ruta_;
+  std::string nombre_;
+  bool dir_ = false;
+  std::shared_ptr<std::vector<std::string>> entradas_;
+  size_t siguiente_ = 0;
+};
+
+class SDFS {
+ public:
+  bool begin(int) {
+    return !sim::raizSD.empty() && std::filesystem::is_directory(sim::raizSD);
+  }
+
+  bool exists(const char *ruta) {
+    return std::filesystem::exists(sim::raizSD + ruta);
+  }
+
+  bool mkdir(const char *ruta) {
+    std::error_code e;
+    return std::filesystem::create_directory(sim::raizSD + ruta, e);
+  }
+
+  bool rmdir(const char *ruta) {
+    std::error_code e;
+    return std::filesystem::is_directory(sim::raizSD + ruta) &&
+           std::filesystem::remove(sim::raizSD + ruta, e);
+  }
+
+  bool remove(const char *ruta) {
+    std::error_code e;
+    return std::filesystem::is_regular_file(sim::raizSD + ruta) &&
+           std::filesystem::remove(sim::raizSD + ruta, e);
+  }
+
+  bool rename(const char *desde, const char *hasta) {
+    std::error_code e;
+    if (std::filesystem::exists(sim::raizSD + hasta)) {
+      return false;
+    }
+    std::filesystem::rename(sim::raizSD + desde, sim::raizSD + hasta, e);
+    return !e;
+  }
+
+  File open(const char *ruta, const char *modo = FILE_READ) {
+    return File::abrir(ruta, modo);
+  }
+};
+
+inline SDFS SD;
+
+#endif
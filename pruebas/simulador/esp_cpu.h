@@ -0,0 +1,15 @@
+/**
+ * @file esp_cpu.h
+ * @brief Contador de ciclos del simulador: nanosegundos del reloj monótono.
+ */
+#ifndef SIMULADOR_ESP_CPU_H
+#define SIMULADOR_ESP_CPU_H
+
+#include <Arduino.h>
+
+inline uint32_t esp_cpu_get_cycle_count() {
+  return (uint32_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif
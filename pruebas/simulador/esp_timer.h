@@ -0,0 +1,10 @@
+/**
+ * @file esp_timer.h
+ * @brief esp_timer_get_time() del simulador (definido en Arduino.h).
+ */
+#ifndef SIMULADOR_ESP_TIMER_H
+#define SIMULADOR_ESP_TIMER_H
+
+#include <Arduino.h>
+
+#endif
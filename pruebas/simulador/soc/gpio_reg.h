@@ -0,0 +1,18 @@
+/**
+ * @file gpio_reg.h
+ * @brief Direcciones de los registros de salida GPIO del ESP32.
+ *
+ * En el PC no hay registros: REG_WRITE no hace nada y las pruebas sustituyen
+ * la escritura con SALIDAS_ESCRIBIR_REGISTRO para contarlas.
+ */
+#ifndef SIMULADOR_GPIO_REG_H
+#define SIMULADOR_GPIO_REG_H
+
+#define GPIO_OUT_W1TS_REG  0x3FF44008
+#define GPIO_OUT_W1TC_REG  0x3FF4400C
+#define GPIO_OUT1_W1TS_REG 0x3FF44014
+#define GPIO_OUT1_W1TC_REG 0x3FF44018
+
+#define REG_WRITE(reg, valor) ((void) (reg), (void) (valor))
+
+#endif
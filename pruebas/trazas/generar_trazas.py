@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""Genera las trazas sintéticas de pruebas/trazas con el formato CSV de la SD.
+
+No son capturas reales: son señales lentas más el ruido de cada sensor, con
+semilla fija. Modelo de ruido (lecturas cada segundo, como el planificador):
+  - DHT11: temperatura con resolución 0.1 °C y ruido 0.15 °C; humedad entera
+    con ruido 0.5 %.
+  - LDR: ADC de 12 bits del ESP32 con ruido 20 cuentas.
+  - MQ-135: ADC con ruido 10 cuentas, convertido a ppm como calcularCO2.
+  - Suelo: ADC con ruido 20 cuentas, convertido a % entero como map().
+
+Trazas:
+  - estable.csv: una hora de día sin sucesos.
+  - incendio.csv: diez minutos; a los 300 s la luz sube 50 cuentas/s y la
+    temperatura 0.1 °C/s durante 20 s (llama junto al LDR).
+
+Uso: python3 generar_trazas.py [directorio]
+"""
+import math
+import os
+import random
+import sys
+import time
+
+INICIO = 1749715200  # 2025-06-12 08:00:00 UTC
+
+
+def co2_ppm(adc):
+    v = adc * (3.3 / 4095.0)
+    ratio = (10000.0 * (3.3 - v) / v) / 10000.0
+    return 10 ** (-2.769 * math.log10(ratio) + 2.691)
+
+
+def suelo_pct(adc):
+    # map(adc, 4092, 0, 0, 100) con aritmética entera de Arduino
+    return max(0, (4092 - adc) * 100 // 4092)
+
+
+def timestamp(t):
+    return time.strftime("%Y-%m-%d %H:%M:%S", time.gmtime(INICIO + t))
+
+
+def escribir(ruta, segundos, senal, rnd):
+    with open(ruta, "w") as f:
+        f.write("timestamp,nodeId,rssi,temp,hum,light,co2ppm,soilMoisture\n")
+        for t in range(segundos):
+            temp, hum, luz, adc_co2, adc_suelo = senal(t)
+            temp = round(temp + rnd.gauss(0, 0.15), 1)
+            hum = round(hum + rnd.gauss(0, 0.5))
+            luz = min(4095, max(0, round(luz + rnd.gauss(0, 20))))
+            co2 = co2_ppm(min(4094, max(1, round(adc_co2 + rnd.gauss(0, 10)))))
+            suelo = suelo_pct(min(4095, max(0, round(adc_suelo + rnd.gauss(0, 20)))))
+            f.write("%s,NODE1,-60,%.2f,%.2f,%d,%.2f,%.2f\n" % (timestamp(t), temp, hum, luz, co2, suelo))
+
+
+def estable(t):
+    # Derivas lentas: ±0.5 °C, ±2 % y ±150 cuentas de luz en una hora
+    fase = 2 * math.pi * t / 3600
+    return (24 + 0.5 * math.sin(fase), 55 + 2 * math.sin(fase + 1),
+            3000 + 150 * math.sin(fase + 2), 2230, 1300)
+
+
+def incendio(t):
+    temp, hum, luz, adc_co2, adc_suelo = estable(t)
+    subida = min(max(t - 300, 0), 20)
+    return (temp + 0.1 * subida, hum, luz + 50 * subida, adc_co2, adc_suelo)
+
+
+def main():
+    destino = sys.argv[1] if len(sys.argv) > 1 else os.path.dirname(os.path.abspath(__file__))
+    rnd = random.Random(20250612)
+    escribir(os.path.join(destino, "estable.csv"), 3600, estable, rnd)
+    escribir(os.path.join(destino, "incendio.csv"), 600, incendio, rnd)
+
+
+if __name__ == "__main__":
+    main()